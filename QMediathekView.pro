@@ -2,12 +2,12 @@ CONFIG += c++11
 
 CONFIG(debug, debug|release) {
     internals.target = $${OUT_PWD}/internals/debug/libinternals.a
-    internals.commands = LZMA_API_STATIC=1 cargo build --manifest-path "$${PWD}/internals/Cargo.toml" --target-dir "$${OUT_PWD}/internals"
+    internals.commands = cargo build --manifest-path "$${PWD}/internals/Cargo.toml" --target-dir "$${OUT_PWD}/internals"
 }
 
 CONFIG(release, debug|release) {
     internals.target = $${OUT_PWD}/internals/release/libinternals.a
-    internals.commands = LZMA_API_STATIC=1 cargo build --manifest-path "$${PWD}/internals/Cargo.toml" --target-dir "$${OUT_PWD}/internals" --release
+    internals.commands = cargo build --manifest-path "$${PWD}/internals/Cargo.toml" --target-dir "$${OUT_PWD}/internals" --release
 }
 
 internals.CONFIG = phony
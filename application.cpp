@@ -45,6 +45,8 @@ namespace
 
 const auto projectName = QStringLiteral("QMediathekView");
 
+constexpr auto progressLogInterval = 5 * 1000;
+
 class ProxyStyle : public QProxyStyle
 {
 public:
@@ -90,20 +92,26 @@ Application::Application(int& argc, char** argv, bool headless)
 
     connect(m_database, &Database::updated, m_model, &Model::update);
 
+    connect(m_database, &Database::updateProgress, this, &Application::progressedDatabaseUpdate);
     connect(m_database, &Database::updated, this, &Application::completedDatabaseUpdate);
     connect(m_database, &Database::failedToUpdate, this, &Application::failedToUpdateDatabase);
+    connect(m_database, &Database::updateCancelled, this, &Application::cancelledDatabaseUpdate);
 
     if (m_mainWindow != nullptr)
     {
         connect(this, &Application::startedDatabaseUpdate, m_mainWindow, &MainWindow::showStartedDatabaseUpdate);
+        connect(this, &Application::progressedDatabaseUpdate, m_mainWindow, &MainWindow::showDatabaseUpdateProgress);
         connect(this, &Application::completedDatabaseUpdate, m_mainWindow, &MainWindow::showCompletedDatabaseUpdate);
         connect(this, &Application::failedToUpdateDatabase, m_mainWindow, &MainWindow::showDatabaseUpdateFailure);
+        connect(this, &Application::cancelledDatabaseUpdate, m_mainWindow, &MainWindow::showCancelledDatabaseUpdate);
     }
     else
     {
         connect(this, &Application::startedDatabaseUpdate, this, &Application::logStartedDatabaseUpdate);
+        connect(this, &Application::progressedDatabaseUpdate, this, &Application::logDatabaseUpdateProgress);
         connect(this, &Application::completedDatabaseUpdate, this, &Application::logCompletedDatabaseUpdate);
         connect(this, &Application::failedToUpdateDatabase, this, &Application::logDatabaseUpdateFailure);
+        connect(this, &Application::cancelledDatabaseUpdate, this, &Application::logDatabaseUpdateCancellation);
     }
 }
 
@@ -180,6 +188,11 @@ void Application::checkUpdateDatabase()
 
 void Application::updateDatabase()
 {
+    if (m_database->isUpdating())
+    {
+        return;
+    }
+
     emit startedDatabaseUpdate();
 
     const auto updatedOn = m_settings->databaseUpdatedOn();
@@ -195,6 +208,11 @@ void Application::updateDatabase()
     }
 }
 
+void Application::cancelUpdateDatabase()
+{
+    m_database->cancelUpdate();
+}
+
 QString Application::preferredUrl(const QModelIndex& index) const
 {
     auto firstUrl = &Model::url;
@@ -275,6 +293,27 @@ void Application::startDownload(const QString& title, const QString& url) const
 void Application::logStartedDatabaseUpdate()
 {
     qInfo() << tr("Started database update...");
+
+    m_progressLogTimer.start();
+}
+
+void Application::logDatabaseUpdateProgress(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted)
+{
+    if (m_progressLogTimer.elapsed() < progressLogInterval)
+    {
+        return;
+    }
+
+    m_progressLogTimer.restart();
+
+    constexpr auto megabyte = 1024.0 * 1024.0;
+
+    qInfo() << tr("Downloaded %1 of %2 MB, decompressed %3 MB, parsed %4 and inserted %5 shows.")
+            .arg(downloaded / megabyte, 0, 'f', 1)
+            .arg(downloadLen > 0 ? QString::number(downloadLen / megabyte, 'f', 1) : tr("unknown"))
+            .arg(decompressed / megabyte, 0, 'f', 1)
+            .arg(parsed)
+            .arg(inserted);
 }
 
 void Application::logCompletedDatabaseUpdate()
@@ -289,6 +328,12 @@ void Application::logDatabaseUpdateFailure(const QString& error)
     quit();
 }
 
+void Application::logDatabaseUpdateCancellation()
+{
+    qWarning() << tr("Cancelled database update.");
+    quit();
+}
+
 } // QMediathekView
 
 int main(int argc, char** argv)
@@ -23,6 +23,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 #define APPLICATION_H
 
 #include <QApplication>
+#include <QElapsedTimer>
 
 class QNetworkAccessManager;
 
@@ -45,8 +46,10 @@ public:
 
 signals:
     void startedDatabaseUpdate();
+    void progressedDatabaseUpdate(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted);
     void completedDatabaseUpdate();
     void failedToUpdateDatabase(const QString& error);
+    void cancelledDatabaseUpdate();
 
 public:
     int exec();
@@ -63,6 +66,7 @@ public:
 
     void checkUpdateDatabase();
     void updateDatabase();
+    void cancelUpdateDatabase();
 
     QString preferredUrl(const QModelIndex& index) const;
 
@@ -71,8 +75,10 @@ private:
     void startDownload(const QString& title, const QString& url) const;
 
     void logStartedDatabaseUpdate();
+    void logDatabaseUpdateProgress(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted);
     void logCompletedDatabaseUpdate();
     void logDatabaseUpdateFailure(const QString& error);
+    void logDatabaseUpdateCancellation();
 
 private:
     Settings* m_settings;
@@ -83,6 +89,8 @@ private:
 
     MainWindow* m_mainWindow;
 
+    QElapsedTimer m_progressLogTimer;
+
 };
 
 } // QMediathekView
@@ -22,6 +22,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 #include "database.h"
 
 #include <QDebug>
+#include <QSet>
 #include <QStandardPaths>
 
 #include "settings.h"
@@ -46,10 +47,23 @@ inline QString toString(const StringData& data)
     return QString::fromUtf8(data.ptr, data.len);
 }
 
+struct SummaryData
+{
+    std::int64_t channel_id;
+    std::int64_t topic_id;
+    StringData title;
+
+    std::int64_t date;
+    std::uint32_t time;
+
+    std::uint32_t duration;
+
+};
+
 struct ShowData
 {
-    StringData channel;
-    StringData topic;
+    std::int64_t channel_id;
+    std::int64_t topic_id;
     StringData title;
 
     std::int64_t date;
@@ -66,26 +80,55 @@ struct ShowData
 
 };
 
+template< typename Value >
+struct Fetched
+{
+    quintptr id;
+
+    std::int64_t channelId;
+    std::int64_t topicId;
+
+    std::unique_ptr< Value > value;
+
+};
+
+using FetchedSummaries = std::vector< Fetched< QMediathekView::ShowSummary > >;
+using FetchedShows = std::vector< Fetched< QMediathekView::Show > >;
+
 }
 
 extern "C"
 {
-    void append_integer(void* integers, std::int64_t data)
+    void append_string(void* strings, StringData data)
     {
-        static_cast< QVector< quintptr >* >(integers)->append(data);
+        static_cast< QStringList* >(strings)->append(toString(data));
     }
 
-    void append_string(void* strings, StringData data)
+    void insert_name(void* names, std::int64_t id, StringData data)
     {
-        static_cast< QStringList* >(strings)->append(toString(data));
+        static_cast< QMediathekView::Database::Names* >(names)->insert(id, toString(data));
     }
 
-    void fetch_show(void* show, const ShowData* data)
+    void fetch_summary(void* summaries, std::int64_t id, const SummaryData* data)
     {
-        const auto show_ = static_cast< QMediathekView::Show* >(show);
+        std::unique_ptr< QMediathekView::ShowSummary > summary(new QMediathekView::ShowSummary);
+        const auto summary_ = summary.get();
+
+        summary_->title = toString(data->title);
+
+        summary_->date =  QDate::fromJulianDay(data->date);
+        summary_->time = QTime::fromMSecsSinceStartOfDay(data->time * 1000);
+
+        summary_->duration = QTime::fromMSecsSinceStartOfDay(data->duration * 1000);
+
+        static_cast< FetchedSummaries* >(summaries)->push_back({ static_cast< quintptr >(id), data->channel_id, data->topic_id, std::move(summary) });
+    }
+
+    void fetch_show(void* shows, std::int64_t id, const ShowData* data)
+    {
+        std::unique_ptr< QMediathekView::Show > show(new QMediathekView::Show);
+        const auto show_ = show.get();
 
-        show_->channel = toString(data->channel);
-        show_->topic = toString(data->topic);
         show_->title = toString(data->title);
 
         show_->date =  QDate::fromJulianDay(data->date);
@@ -99,47 +142,108 @@ extern "C"
         show_->url = toString(data->url);
         show_->urlSmall = toString(data->url_small);
         show_->urlLarge = toString(data->url_large);
+
+        static_cast< FetchedShows* >(shows)->push_back({ static_cast< quintptr >(id), data->channel_id, data->topic_id, std::move(show) });
     }
 
-    Internals* internals_init(const char* path, bool* needs_update);
+    Internals* internals_init(const char* path, std::size_t blob_cache_len, bool* needs_update);
     void internals_drop(Internals* internals);
 
+    void internals_blob_cache_stats(const Internals* internals, std::uint64_t* hits, std::uint64_t* misses);
+
+    struct ProgressData
+    {
+        std::uint64_t download_len;
+        std::uint64_t downloaded;
+        std::uint64_t decompressed;
+        std::uint64_t parsed;
+        std::uint64_t inserted;
+    };
+
+    struct UpdateProgress
+    {
+        void* context;
+        void (*action)(void* context, const ProgressData* data);
+    };
+
     struct Completion
     {
         void* context;
-        void (*action)(void* context, const char* error);
+        void (*action)(void* context, const char* error, bool cancelled);
     };
 
-    void internals_full_update(
-        Internals* internals,
+    struct Indexes
+    {
+        bool descriptions;
+        bool title_trigrams;
+    };
+
+    UpdateHandle* internals_full_update(
+        const Internals* internals,
         const char* url,
+        Indexes indexes,
+        UpdateProgress progress,
         Completion completion);
-    void internals_partial_update(
-        Internals* internals,
+    UpdateHandle* internals_partial_update(
+        const Internals* internals,
         const char* url,
+        UpdateProgress progress,
         Completion completion);
+    void internals_cancel_update(const UpdateHandle* handle);
+    void internals_drop_update(UpdateHandle* handle);
+
+    Indexes internals_indexes(const Internals* internals);
 
     void internals_channels(
-        Internals* internals,
+        const Internals* internals,
         void* channels);
     void internals_topics(
-        Internals* internals,
+        const Internals* internals,
         StringData channel,
         void* topics);
 
+    void internals_names(
+        const Internals* internals,
+        void* channels,
+        void* topics);
+
+    struct QueryCompletion
+    {
+        void* context;
+        void (*action)(void* context, std::uint64_t generation, std::size_t count, bool fuzzy);
+    };
+
     void internals_query(
-        Internals* internals,
+        const Internals* internals,
+        std::uint64_t generation,
         StringData channel,
         StringData topic,
         StringData title,
+        StringData description,
         QMediathekView::Database::SortColumn sortColumn,
         QMediathekView::Database::SortOrder sortOrder,
-        void* ids);
-
-    void internals_fetch(
-        Internals* internals,
-        std::int64_t id,
-        void* show);
+        QueryCompletion completion);
+    std::size_t internals_query_window(
+        const Internals* internals,
+        std::uint64_t generation,
+        std::size_t offset,
+        std::size_t len,
+        quintptr* ids);
+    void internals_query_release(
+        const Internals* internals,
+        std::uint64_t generation);
+
+    void internals_fetch_summaries(
+        const Internals* internals,
+        const quintptr* ids,
+        std::size_t len,
+        void* summaries);
+
+    void internals_fetch_many(
+        const Internals* internals,
+        const quintptr* ids,
+        std::size_t len,
+        void* shows);
 }
 
 namespace QMediathekView
@@ -148,11 +252,17 @@ namespace QMediathekView
 Database::Database(Settings& settings, QObject* parent)
     : QObject(parent)
     , m_settings(settings)
+    , m_update(nullptr)
 {
+    connect(this, &Database::updated, this, &Database::dropUpdate);
+    connect(this, &Database::failedToUpdate, this, &Database::dropUpdate);
+    connect(this, &Database::updateCancelled, this, &Database::dropUpdate);
+
     const auto path = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    const auto blobCacheLen = static_cast< std::size_t >(qMax(m_settings.blobCacheSize(), 0)) * 1024 * 1024;
     bool needsUpdate = false;
 
-    m_internals = internals_init(path.toLocal8Bit().constData(), &needsUpdate);
+    m_internals = internals_init(path.toLocal8Bit().constData(), blobCacheLen, &needsUpdate);
 
     if(needsUpdate)
     {
@@ -162,6 +272,13 @@ Database::Database(Settings& settings, QObject* parent)
 
 Database::~Database()
 {
+    // Dropping the update waits for its thread, which must finish before the internals are dropped.
+    if(m_update != nullptr)
+    {
+        internals_cancel_update(m_update);
+        internals_drop_update(m_update);
+    }
+
     if(m_internals != nullptr)
     {
         internals_drop(m_internals);
@@ -170,11 +287,13 @@ Database::~Database()
 
 void Database::fullUpdate(const QString& url)
 {
-    if(m_internals != nullptr)
+    if(m_internals != nullptr && m_update == nullptr)
     {
-        internals_full_update(
+        m_update = internals_full_update(
             m_internals,
             url.toUtf8().constData(),
+            Indexes { m_settings.indexDescriptions(), m_settings.substringTitleSearch() },
+            UpdateProgress { this, updateProgressed },
             Completion { this, updateCompleted }
         );
     }
@@ -182,20 +301,63 @@ void Database::fullUpdate(const QString& url)
 
 void Database::partialUpdate(const QString& url)
 {
-    if(m_internals != nullptr)
+    if(m_internals != nullptr && m_update == nullptr)
     {
-        internals_partial_update(
+        m_update = internals_partial_update(
             m_internals,
             url.toUtf8().constData(),
+            UpdateProgress { this, updateProgressed },
             Completion { this, updateCompleted }
         );
     }
 }
 
-void Database::updateCompleted(void* context, const char* error)
+bool Database::isUpdating() const
+{
+    return m_update != nullptr;
+}
+
+void Database::cancelUpdate()
+{
+    if(m_update != nullptr)
+    {
+        internals_cancel_update(m_update);
+    }
+}
+
+void Database::dropUpdate()
+{
+    if(m_update != nullptr)
+    {
+        internals_drop_update(m_update);
+        m_update = nullptr;
+    }
+}
+
+void Database::updateProgressed(void* context, const ProgressData* data)
+{
+    Database* self = static_cast< Database* >(context);
+
+    emit self->updateProgress(
+        static_cast< qint64 >(data->download_len),
+        static_cast< qint64 >(data->downloaded),
+        static_cast< qint64 >(data->decompressed),
+        static_cast< qint64 >(data->parsed),
+        static_cast< qint64 >(data->inserted)
+    );
+}
+
+void Database::updateCompleted(void* context, const char* error, bool cancelled)
 {
     Database* self = static_cast< Database* >(context);
 
+    if (cancelled)
+    {
+        emit self->updateCancelled();
+
+        return;
+    }
+
     if (error != nullptr)
     {
         emit self->failedToUpdate(QString::fromUtf8(error));
@@ -203,41 +365,221 @@ void Database::updateCompleted(void* context, const char* error)
         return;
     }
 
+    // IDs are reused by full updates, so the names must be cleared before anyone is notified and queries again.
+    // Summaries resolved between the commit and this point are dropped by the model when it is notified.
+    self->clearNames();
+
     self->m_settings.setDatabaseUpdatedOn();
 
     emit self->updated();
 }
 
-QVector< quintptr > Database::query(const QString& channel, const QString& topic, const QString& title, SortColumn sortColumn, SortOrder sortOrder) const
+void Database::query(quint64 generation, const QString& channel, const QString& topic, const QString& title, const QString& description, SortColumn sortColumn, SortOrder sortOrder)
 {
-    QVector< quintptr > ids;
+    if(m_internals == nullptr)
+    {
+        emit queried(generation, 0, false);
+
+        return;
+    }
+
+    const auto channel_ = channel.toUtf8();
+    const auto topic_ = topic.toUtf8();
+    const auto title_ = title.toUtf8();
+    const auto description_ = description.toUtf8();
+
+    internals_query(
+        m_internals,
+        generation,
+        fromBytes(channel_), fromBytes(topic_), fromBytes(title_), fromBytes(description_),
+        sortColumn, sortOrder,
+        QueryCompletion { this, queryCompleted }
+    );
+}
+
+void Database::queryCompleted(void* context, std::uint64_t generation, std::size_t count, bool fuzzy)
+{
+    Database* self = static_cast< Database* >(context);
+
+    emit self->queried(generation, static_cast< int >(count), fuzzy);
+}
+
+QVector< quintptr > Database::window(quint64 generation, int offset, int len) const
+{
+    if(m_internals == nullptr)
+    {
+        return {};
+    }
+
+    QVector< quintptr > ids(len);
+
+    const auto fetched = internals_query_window(
+        m_internals,
+        generation,
+        static_cast< std::size_t >(offset),
+        static_cast< std::size_t >(len),
+        ids.data()
+    );
+
+    ids.resize(static_cast< int >(fetched));
+
+    return ids;
+}
+
+void Database::releaseResults(quint64 generation) const
+{
+    if(m_internals == nullptr)
+    {
+        return;
+    }
+
+    internals_query_release(m_internals, generation);
+}
+
+Database::Summaries Database::summaries(const QVector< quintptr >& ids) const
+{
+    FetchedSummaries fetched;
+    fetched.reserve(ids.size());
 
     if(m_internals != nullptr)
     {
-        const auto channel_ = channel.toUtf8();
-        const auto topic_ = topic.toUtf8();
-        const auto title_ = title.toUtf8();
+        internals_fetch_summaries(m_internals, ids.constData(), ids.size(), &fetched);
+    }
 
-        internals_query(
-            m_internals,
-            fromBytes(channel_), fromBytes(topic_), fromBytes(title_),
-            sortColumn, sortOrder,
-            &ids);
+    Summaries summaries;
+    summaries.reserve(fetched.size());
+
+    {
+        QMutexLocker locker(&m_namesMutex);
+
+        // Any unknown ID means that the cached names are outdated, so they are reloaded at most once per batch.
+        for(const auto& summary : fetched)
+        {
+            if(!m_channelNames.contains(summary.channelId) || !m_topicNames.contains(summary.topicId))
+            {
+                fetchNames();
+                break;
+            }
+        }
+
+        for(auto& summary : fetched)
+        {
+            summary.value->channel = m_channelNames.value(summary.channelId);
+            summary.value->topic = m_topicNames.value(summary.topicId);
+
+            summaries.emplace_back(summary.id, std::move(summary.value));
+        }
     }
 
-    return ids;
+    // Shows deleted by a partial update since the query yield empty placeholders so that they are not fetched again.
+    if(summaries.size() < static_cast< std::size_t >(ids.size()))
+    {
+        QSet< quintptr > found;
+        found.reserve(static_cast< int >(summaries.size()));
+
+        for(const auto& summary : summaries)
+        {
+            found.insert(summary.first);
+        }
+
+        for(const auto id : ids)
+        {
+            if(!found.contains(id))
+            {
+                summaries.emplace_back(id, std::unique_ptr< ShowSummary >(new ShowSummary));
+            }
+        }
+    }
+
+    return summaries;
 }
 
 std::unique_ptr< Show > Database::show(const quintptr id) const
 {
-    std::unique_ptr< Show > show(new Show);
+    FetchedShows fetched;
+
+    if(m_internals != nullptr)
+    {
+        internals_fetch_many(m_internals, &id, 1, &fetched);
+    }
+
+    if(fetched.empty())
+    {
+        return std::unique_ptr< Show >(new Show);
+    }
+
+    auto& show = fetched.front();
+
+    show.value->channel = channelName(show.channelId);
+    show.value->topic = topicName(show.topicId);
+
+    return std::move(show.value);
+}
+
+QString Database::channelName(const qint64 id) const
+{
+    QMutexLocker locker(&m_namesMutex);
+
+    if(!m_channelNames.contains(id))
+    {
+        fetchNames();
+    }
+
+    return m_channelNames.value(id);
+}
+
+QString Database::topicName(const qint64 id) const
+{
+    QMutexLocker locker(&m_namesMutex);
+
+    if(!m_topicNames.contains(id))
+    {
+        fetchNames();
+    }
+
+    return m_topicNames.value(id);
+}
+
+void Database::fetchNames() const
+{
+    m_channelNames.clear();
+    m_topicNames.clear();
+
+    if(m_internals != nullptr)
+    {
+        internals_names(m_internals, &m_channelNames, &m_topicNames);
+    }
+}
+
+void Database::clearNames()
+{
+    QMutexLocker locker(&m_namesMutex);
+
+    m_channelNames.clear();
+    m_topicNames.clear();
+}
+
+bool Database::descriptionsIndexed() const
+{
+    if(m_internals == nullptr)
+    {
+        return false;
+    }
+
+    return internals_indexes(m_internals).descriptions;
+}
+
+std::pair< quint64, quint64 > Database::blobCacheStats() const
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
 
     if(m_internals != nullptr)
     {
-        internals_fetch(m_internals, id, show.get());
+        internals_blob_cache_stats(m_internals, &hits, &misses);
     }
 
-    return show;
+    return { hits, misses };
 }
 
 QStringList Database::channels() const
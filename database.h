@@ -22,13 +22,20 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <cstdint>
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 
 #include "schema.h"
 
 struct Internals;
+struct ProgressData;
+struct UpdateHandle;
 
 namespace QMediathekView
 {
@@ -47,19 +54,30 @@ public:
 signals:
     void updated();
     void failedToUpdate(const QString& error);
+    void updateCancelled();
+
+    // Emitted a few times per second while an update is running, the download length is zero if unknown.
+    void updateProgress(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted);
+
+    void queried(quint64 generation, int count, bool fuzzy);
 
 public:
     void fullUpdate(const QString& url);
     void partialUpdate(const QString& url);
 
+    bool isUpdating() const;
+    void cancelUpdate();
+
 public:
     enum SortColumn
     {
         SortChannel,
         SortTopic,
+        SortTitle,
         SortDate,
         SortTime,
-        SortDuration
+        SortDuration,
+        SortRelevance
     };
 
     enum SortOrder
@@ -68,20 +86,54 @@ public:
         SortDescending,
     };
 
-    QVector< quintptr > query(const QString& channel, const QString& topic, const QString& title, SortColumn sortColumn, SortOrder sortOrder) const;
+    void query(quint64 generation, const QString& channel, const QString& topic, const QString& title, const QString& description, SortColumn sortColumn, SortOrder sortOrder);
+
+    // The results of a completed query are kept by the internals and fetched window by window.
+    QVector< quintptr > window(quint64 generation, int offset, int len) const;
+    // Releases the results of all queries older than the given generation.
+    void releaseResults(quint64 generation) const;
 
 public:
+    using Summaries = std::vector< std::pair< quintptr, std::unique_ptr< ShowSummary > > >;
+
+    Summaries summaries(const QVector< quintptr >& ids) const;
     std::unique_ptr< Show > show(const quintptr id) const;
 
+    // Whether the last full update built the optional description index, independently of the current settings.
+    bool descriptionsIndexed() const;
+
+    // Hits and misses of the blob cache since startup, e.g. to tune its size.
+    std::pair< quint64, quint64 > blobCacheStats() const;
+
     QStringList channels() const;
     QStringList topics(const QString& channel) const;
 
+    using Names = QHash< qint64, QString >;
+
 private:
     Settings& m_settings;
 
     Internals* m_internals;
 
-    static void updateCompleted(void* context, const char* error);
+    // Set while an update is running, only accessed from the main thread.
+    UpdateHandle* m_update;
+
+    void dropUpdate();
+
+    // The internals can be used from any thread, so only the name caches need to be protected.
+    mutable QMutex m_namesMutex;
+    mutable Names m_channelNames;
+    mutable Names m_topicNames;
+
+    QString channelName(const qint64 id) const;
+    QString topicName(const qint64 id) const;
+
+    void fetchNames() const;
+    void clearNames();
+
+    static void updateProgressed(void* context, const ProgressData* data);
+    static void updateCompleted(void* context, const char* error, bool cancelled);
+    static void queryCompleted(void* context, std::uint64_t generation, std::size_t count, bool fuzzy);
 
 };
 
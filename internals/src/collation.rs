@@ -0,0 +1,193 @@
+pub fn collation_key(text: &str) -> String {
+    let mut key = String::with_capacity(text.len());
+
+    for c in text.chars().flat_map(char::to_lowercase) {
+        if push_base_letter(&mut key, c) {
+            continue;
+        }
+
+        match c {
+            c if c.is_alphanumeric() => key.push(c),
+            c if c.is_whitespace() => {
+                if !key.is_empty() && !key.ends_with(' ') {
+                    key.push(' ');
+                }
+            }
+            _ => (),
+        }
+    }
+
+    if key.ends_with(' ') {
+        key.pop();
+    }
+
+    key
+}
+
+// Folds umlauts into their transcriptions and other diacritics into their base letters,
+// e.g. "Gärten" and "Gaerten" both become "gaerten" while "Aero" stays "aero".
+pub fn fold(text: &str) -> String {
+    let mut folded = String::with_capacity(text.len());
+
+    for c in text.chars().flat_map(char::to_lowercase) {
+        match c {
+            'ä' => folded.push_str("ae"),
+            'ö' => folded.push_str("oe"),
+            'ü' => folded.push_str("ue"),
+            c if push_base_letter(&mut folded, c) => (),
+            c => folded.push(c),
+        }
+    }
+
+    folded
+}
+
+// Titles are indexed folded, followed by the base letter spelling of each word containing umlauts,
+// so that "Gärten" is found by "Gärten", "Gaerten" and "Garten" alike.
+pub fn index_title(title: &str) -> String {
+    let mut indexed = fold(title);
+
+    for word in title.split(|c: char| !c.is_alphanumeric()) {
+        let word = word.to_lowercase();
+
+        if word.contains(['ä', 'ö', 'ü']) {
+            indexed.push(' ');
+
+            for c in word.chars() {
+                if !push_base_letter(&mut indexed, c) {
+                    indexed.push(c);
+                }
+            }
+        }
+    }
+
+    indexed
+}
+
+fn push_base_letter(text: &mut String, c: char) -> bool {
+    match c {
+        'ä' | 'à' | 'á' | 'â' | 'ã' | 'å' => text.push('a'),
+        'æ' => text.push_str("ae"),
+        'ç' | 'č' => text.push('c'),
+        'è' | 'é' | 'ê' | 'ë' => text.push('e'),
+        'ì' | 'í' | 'î' | 'ï' => text.push('i'),
+        'ñ' => text.push('n'),
+        'ö' | 'ò' | 'ó' | 'ô' | 'õ' | 'ø' => text.push('o'),
+        'œ' => text.push_str("oe"),
+        'ß' => text.push_str("ss"),
+        'š' => text.push('s'),
+        'ü' | 'ù' | 'ú' | 'û' => text.push('u'),
+        'ý' | 'ÿ' => text.push('y'),
+        'ž' => text.push('z'),
+        _ => return false,
+    }
+
+    true
+}
+
+// Channels and topics use the same folding as titles, so that filtering and searching agree on umlauts.
+// It keeps all other characters so that keys can be searched by prefix.
+pub fn search_key(text: &str) -> String {
+    fold(text)
+}
+
+// The smallest string larger than all strings starting with the given prefix,
+// except for the empty prefix which is bounded by the largest code point.
+pub fn prefix_end(prefix: &str) -> String {
+    let mut end = prefix.to_owned();
+
+    while let Some(c) = end.pop() {
+        let next = match c as u32 + 1 {
+            0xD800 => Some('\u{E000}'),
+            next => char::from_u32(next),
+        };
+
+        if let Some(next) = next {
+            end.push(next);
+            return end;
+        }
+    }
+
+    end.push(char::MAX);
+    end
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn folds_case_and_diacritics() {
+        assert_eq!(collation_key("Über Straßen"), "uber strassen");
+        assert_eq!(
+            collation_key("\"Tatort\" - Côte d'Azur "),
+            "tatort cote dazur"
+        );
+
+        let mut titles = vec!["Zoo", "Ärger", "apfel", "Öl", "ober"];
+        titles.sort_by_key(|title| collation_key(title));
+
+        assert_eq!(titles, ["apfel", "Ärger", "ober", "Öl", "Zoo"]);
+    }
+
+    #[test]
+    fn folds_alternative_spellings() {
+        assert_eq!(fold("Gärten"), "gaerten");
+        assert_eq!(fold("Gaerten"), "gaerten");
+        assert_eq!(fold("Straße"), fold("Strasse"));
+        assert_eq!(fold("Œuvre"), fold("Oeuvre"));
+        assert_eq!(fold("Café au lait"), "cafe au lait");
+
+        assert!(fold("Gärtnerei").starts_with(&fold("Gae")));
+        assert!(fold("Gärtnerei").starts_with(&fold("Gä")));
+    }
+
+    #[test]
+    fn keeps_plain_vowel_pairs() {
+        for title in ["Aero", "Quelle", "Michael", "neue", "Poet", "Blues"] {
+            assert_eq!(fold(title), title.to_lowercase());
+        }
+
+        assert_eq!(index_title("Michael Aero"), "michael aero");
+    }
+
+    #[test]
+    fn indexes_all_umlaut_spellings() {
+        assert_eq!(index_title("Die Gärten"), "die gaerten garten");
+        assert_eq!(
+            index_title("Über Öl-Förderung"),
+            "ueber oel-foerderung uber ol forderung"
+        );
+
+        for query in ["Gärten", "Gaerten", "Garten", "gar", "gae"] {
+            let query = fold(query);
+
+            assert!(index_title("Die Gärten")
+                .split(' ')
+                .any(|token| token.starts_with(&query)));
+        }
+    }
+
+    #[test]
+    fn search_keys_ignore_diacritics() {
+        assert_eq!(search_key("ZDF Info"), "zdf info");
+        assert_eq!(search_key("Arte.FR"), "arte.fr");
+        assert_eq!(search_key("Länderspiegel"), search_key("Laenderspiegel"));
+        assert_eq!(search_key("Straße"), "strasse");
+        assert_eq!(search_key("Côte"), "cote");
+
+        assert!(search_key("Ärger").starts_with(&search_key("Ae")));
+        assert!(search_key("Ärger").starts_with(&search_key("Ä")));
+        assert!(search_key("Aero").starts_with(&search_key("Ae")));
+    }
+
+    #[test]
+    fn prefix_end_bounds_prefix_range() {
+        assert_eq!(prefix_end("ard"), "are");
+        assert_eq!(prefix_end("a\u{D7FF}"), "a\u{E000}");
+        assert_eq!(prefix_end("a\u{10FFFF}"), "b");
+        assert_eq!(prefix_end(""), "\u{10FFFF}");
+
+        assert!("ard" < "ard alpha" && "ard alpha" < prefix_end("ard").as_str());
+    }
+}
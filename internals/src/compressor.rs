@@ -1,14 +1,26 @@
 use std::convert::TryInto;
 use std::mem::replace;
-use std::sync::mpsc::{channel, Receiver, Sender};
+use std::num::NonZeroU32;
+use std::ops::Range;
+use std::sync::{
+    mpsc::{channel, Receiver, Sender},
+    Arc,
+};
 
 use rayon_core::spawn;
-use zstd_safe::{compress_bound, get_error_name, get_frame_content_size, CCtx, DCtx};
+use zstd_safe::{
+    compress_bound, get_dict_id_from_dict, get_dict_id_from_frame, get_error_name,
+    get_frame_content_size, train_from_buffer, CCtx, CDict, DCtx, DDict,
+};
 
 use super::Fallible;
 
 const COMPRESSION_LEVEL: i32 = 12;
 
+const DICTIONARY_LEN: usize = 112 * 1024;
+
+const FRAME_LEN: usize = 16 * 1024;
+
 pub struct BackgroundCompressor<T> {
     compr: Compressor,
     sender: Sender<Fallible<(T, Compressor)>>,
@@ -16,16 +28,22 @@ pub struct BackgroundCompressor<T> {
 }
 
 impl<T: Send + 'static> BackgroundCompressor<T> {
-    pub fn new() -> Self {
+    pub fn new(dict: Option<&[u8]>) -> Self {
         let (sender, receiver) = channel();
 
+        let dict = dict.map(|dict| Arc::new(CDict::create(dict, COMPRESSION_LEVEL)));
+
         Self {
-            compr: Compressor::new(),
+            compr: Compressor::new(dict),
             sender,
             receiver,
         }
     }
 
+    pub fn begin_record(&mut self) {
+        self.compr.begin_record()
+    }
+
     pub fn push(&mut self, text: &str) -> Fallible<u32> {
         self.compr.push(text)
     }
@@ -36,17 +54,18 @@ impl<T: Send + 'static> BackgroundCompressor<T> {
 
     pub fn rotate<F>(&mut self, tag: T, f: F) -> Fallible
     where
-        F: FnOnce(T, &[u8]) -> Fallible,
+        F: FnOnce(T, &[u8], &[u8]) -> Fallible,
     {
         let done = if let Ok(task) = self.receiver.try_recv() {
             let (tag, mut done) = task?;
-            f(tag, &done.compr_buf)?;
+            f(tag, &done.compr_buf, &done.index)?;
 
             done.buf.clear();
+            done.frames.clear();
 
             done
         } else {
-            Compressor::new()
+            Compressor::new(self.compr.dict.clone())
         };
 
         let mut todo = replace(&mut self.compr, done);
@@ -61,7 +80,7 @@ impl<T: Send + 'static> BackgroundCompressor<T> {
 
     pub fn finish<F>(self, tag: T, mut f: F) -> Fallible
     where
-        F: FnMut(T, &[u8]) -> Fallible,
+        F: FnMut(T, &[u8], &[u8]) -> Fallible,
     {
         if !self.compr.buf.is_empty() {
             let mut todo = self.compr;
@@ -76,7 +95,7 @@ impl<T: Send + 'static> BackgroundCompressor<T> {
 
         for task in self.receiver.iter() {
             let (tag, done) = task?;
-            f(tag, &done.compr_buf)?;
+            f(tag, &done.compr_buf, &done.index)?;
         }
 
         Ok(())
@@ -91,16 +110,31 @@ fn spawn_task<T: Send + 'static, F: FnOnce() -> T + Send + 'static>(sender: Send
 
 struct Compressor {
     ctx: CCtx<'static>,
+    dict: Option<Arc<CDict<'static>>>,
     compr_buf: Vec<u8>,
+    index: Vec<u8>,
     buf: Vec<u8>,
+    frames: Vec<usize>,
 }
 
 impl Compressor {
-    fn new() -> Self {
+    fn new(dict: Option<Arc<CDict<'static>>>) -> Self {
         Self {
             ctx: CCtx::create(),
+            dict,
             compr_buf: Vec::new(),
+            index: Vec::new(),
             buf: Vec::new(),
+            frames: Vec::new(),
+        }
+    }
+
+    // Frames end only at record boundaries so that a record is never split between two frames.
+    fn begin_record(&mut self) {
+        let start = self.frames.last().copied().unwrap_or(0);
+
+        if self.buf.len() - start >= FRAME_LEN {
+            self.frames.push(self.buf.len());
         }
     }
 
@@ -118,40 +152,67 @@ impl Compressor {
     }
 
     fn compress(&mut self) -> Fallible {
-        self.compr_buf.resize(compress_bound(self.buf.len()), 0);
+        self.compr_buf.clear();
+        self.index.clear();
 
-        match self
-            .ctx
-            .compress(&mut self.compr_buf, &self.buf, COMPRESSION_LEVEL)
-        {
-            Ok(len) => {
-                self.compr_buf.truncate(len);
+        if self.frames.last() != Some(&self.buf.len()) {
+            self.frames.push(self.buf.len());
+        }
+
+        let mut start = 0;
+
+        for &end in &self.frames {
+            let frame = &self.buf[start..end];
+
+            let compr_start = self.compr_buf.len();
+            self.compr_buf
+                .resize(compr_start + compress_bound(frame.len()), 0);
+
+            let compr_frame = &mut self.compr_buf[compr_start..];
 
-                Ok(())
+            let res = match &self.dict {
+                Some(dict) => self.ctx.compress_using_cdict(compr_frame, frame, dict),
+                None => self.ctx.compress(compr_frame, frame, COMPRESSION_LEVEL),
+            };
+
+            match res {
+                Ok(len) => self.compr_buf.truncate(compr_start + len),
+                Err(err) => {
+                    return Err(format!("Zstd compression failed: {}", get_error_name(err)).into())
+                }
             }
-            Err(err) => Err(format!("Zstd compression failed: {}", get_error_name(err)).into()),
+
+            let end: u32 = end.try_into().unwrap();
+            let compr_end: u32 = self.compr_buf.len().try_into().unwrap();
+
+            self.index.extend_from_slice(&end.to_le_bytes());
+            self.index.extend_from_slice(&compr_end.to_le_bytes());
+
+            start = end as usize;
         }
+
+        Ok(())
     }
 }
 
-pub struct Decompressor {
+struct Decompressor {
     ctx: DCtx<'static>,
     buf: Vec<u8>,
 }
 
 impl Decompressor {
-    pub fn new() -> Self {
+    fn new() -> Self {
         Self {
             ctx: DCtx::create(),
             buf: Vec::new(),
         }
     }
 
-    pub fn buf(&self) -> &[u8] {
-        &self.buf
-    }
-
-    pub fn decompress<'a>(&'a mut self, compr_buf: &[u8]) -> Fallible<&'a [u8]> {
+    fn decompress<'a>(
+        &'a mut self,
+        compr_buf: &[u8],
+        dict: Option<&Dictionary>,
+    ) -> Fallible<&'a [u8]> {
         match get_frame_content_size(compr_buf) {
             Ok(Some(len)) => self.buf.resize(len.try_into().unwrap(), 0),
             Ok(None) | Err(_) => {
@@ -159,7 +220,14 @@ impl Decompressor {
             }
         }
 
-        match self.ctx.decompress(&mut self.buf, compr_buf) {
+        let res = match dict {
+            Some(dict) => self
+                .ctx
+                .decompress_using_ddict(&mut self.buf, compr_buf, &dict.0),
+            None => self.ctx.decompress(&mut self.buf, compr_buf),
+        };
+
+        match res {
             Ok(len) => {
                 self.buf.truncate(len);
 
@@ -169,3 +237,81 @@ impl Decompressor {
         }
     }
 }
+
+pub fn decompress(compr_buf: &[u8], dict: Option<&Dictionary>) -> Fallible<Vec<u8>> {
+    let mut decompr = Decompressor::new();
+    decompr.decompress(compr_buf, dict)?;
+
+    Ok(decompr.buf)
+}
+
+// The frame index stores the uncompressed and compressed end offsets of each frame.
+pub fn find_frame(index: &[u8], offset: u32) -> Option<(Range<u32>, Range<usize>)> {
+    let mut start = 0;
+    let mut compr_start = 0;
+
+    for entry in index.chunks_exact(8) {
+        let end = u32::from_le_bytes(entry[..4].try_into().unwrap());
+        let compr_end = u32::from_le_bytes(entry[4..].try_into().unwrap());
+
+        if offset < end {
+            return Some((start..end, compr_start as usize..compr_end as usize));
+        }
+
+        start = end;
+        compr_start = compr_end;
+    }
+
+    None
+}
+
+pub struct Dictionary(DDict<'static>);
+
+impl Dictionary {
+    pub fn new(dict: &[u8]) -> Self {
+        Self(DDict::create(dict))
+    }
+
+    pub fn id(compr_buf: &[u8]) -> Option<u32> {
+        get_dict_id_from_frame(compr_buf).map(NonZeroU32::get)
+    }
+}
+
+pub struct Trainer {
+    buf: Vec<u8>,
+    lens: Vec<usize>,
+}
+
+impl Trainer {
+    pub fn new() -> Self {
+        Self {
+            buf: Vec::new(),
+            lens: Vec::new(),
+        }
+    }
+
+    pub fn push<'a, I>(&mut self, texts: I)
+    where
+        I: IntoIterator<Item = &'a str>,
+    {
+        let len = self.buf.len();
+
+        for text in texts {
+            self.buf.extend_from_slice(text.as_bytes());
+            self.buf.push(b'\0');
+        }
+
+        self.lens.push(self.buf.len() - len);
+    }
+
+    // Training fails if there are too few samples, in which case blobs are compressed without a dictionary.
+    pub fn train(&self) -> Option<(u32, Vec<u8>)> {
+        let mut dict = Vec::with_capacity(DICTIONARY_LEN);
+
+        train_from_buffer(&mut dict, &self.buf, &self.lens).ok()?;
+
+        let id = get_dict_id_from_dict(&dict)?;
+
+        Some((id.get(), dict))
+    }
+}
@@ -1,76 +1,77 @@
+use std::cmp::Reverse;
+use std::collections::{BTreeMap, HashMap};
 use std::fs::{create_dir_all, remove_file};
-use std::iter::from_fn;
+use std::iter::{from_fn, once};
 use std::mem::replace;
-use std::path::Path;
-use std::sync::mpsc::Receiver;
+use std::ops::Range;
+use std::ops::{Deref, DerefMut};
+use std::path::{Path, PathBuf};
+use std::str::from_utf8;
+use std::sync::{
+    atomic::{AtomicBool, AtomicU64, Ordering},
+    mpsc::Receiver,
+    Arc, Mutex,
+};
 
 use memchr::memchr;
-use rusqlite::{params, Connection, OpenFlags, OptionalExtension, Statement};
+use rayon::prelude::*;
+use rayon_core::{join, scope};
+use rusqlite::{params, Connection, OpenFlags, OptionalExtension, Statement, MAIN_DB};
 use time::Time;
 
 use super::{
-    compressor::{BackgroundCompressor, Decompressor},
+    collation::{collation_key, index_title, search_key},
+    compressor::{decompress, find_frame, BackgroundCompressor, Dictionary, Trainer},
     parser::Item,
-    Fallible,
+    Fallible, Indexes,
 };
 
-const TEXT_BLOB_LEN: usize = 256 * 1024;
-const URL_BLOB_LEN: usize = 512 * 1024;
-
-pub const URL_SMALL: u32 = 0b01;
-pub const URL_LARGE: u32 = 0b10;
-
-pub fn open_connection(path: &Path) -> Fallible<Connection> {
-    let conn = Connection::open_with_flags(
-        path,
-        OpenFlags::default() | OpenFlags::SQLITE_OPEN_PRIVATE_CACHE,
-    )?;
-
-    conn.pragma_update(None, "journal_mode", "WAL")?;
-    conn.pragma_update(None, "synchronous", "NORMAL")?;
-
-    Ok(conn)
-}
-
-pub fn create_schema(path: &Path) -> Fallible<(Connection, bool)> {
-    create_dir_all(path.parent().unwrap())?;
-
-    let mut conn = open_connection(path)?;
+const TITLE_BLOB_LEN: usize = 64 * 1024;
+const DESCRIPTION_BLOB_LEN: usize = 128 * 1024;
+const URL_BLOB_LEN: usize = 128 * 1024;
 
-    let user_version: i32 = conn.pragma_query_value(None, "user_version", |row| row.get(0))?;
+const DICTIONARY_SAMPLES: usize = 20_000;
 
-    if user_version == 8 {
-        return Ok((conn, false));
-    }
+const TITLE_DICTIONARY: i64 = 0;
+const DESCRIPTION_DICTIONARY: i64 = 1;
+const URL_DICTIONARY: i64 = 2;
 
-    remove_file(path)?;
+const UPDATE_CACHE_LEN: usize = 16 * 1024 * 1024;
 
-    conn = open_connection(path)?;
+pub const URL_SMALL: u32 = 0b01;
+pub const URL_LARGE: u32 = 0b10;
 
-    conn.execute_batch(
-        r#"
+pub const SCHEMA: &str = r#"
 BEGIN;
 
 CREATE TABLE channels (
     id INTEGER PRIMARY KEY,
     channel TEXT NOT NULL,
+    channel_key TEXT NOT NULL,
     UNIQUE (channel)
 );
 
+CREATE INDEX channels_by_key ON channels (channel_key);
+
 CREATE TABLE topics (
     id INTEGER PRIMARY KEY,
     topic TEXT NOT NULL,
+    topic_key TEXT NOT NULL,
     channel_id INTEGER NOT NULL,
     UNIQUE (topic, channel_id)
 );
 
+CREATE INDEX topics_by_key ON topics (topic_key);
+
 CREATE INDEX topics_by_channel ON topics (channel_id);
 
 CREATE TABLE shows (
     id INTEGER PRIMARY KEY AUTOINCREMENT,
     topic_id INTEGER NOT NULL,
-    text_blob_id INTEGER NOT NULL,
-    text_offset INTEGER NOT NULL,
+    title_blob_id INTEGER NOT NULL,
+    title_offset INTEGER NOT NULL,
+    description_blob_id INTEGER NOT NULL,
+    description_offset INTEGER NOT NULL,
     url_blob_id INTEGER NOT NULL,
     url_offset INTEGER NOT NULL,
     url_mask INTEGER NOT NULL,
@@ -83,38 +84,177 @@ CREATE INDEX shows_by_topic ON shows (topic_id ASC, date DESC, time DESC);
 
 CREATE VIRTUAL TABLE shows_by_title USING FTS5 (title, content='', contentless_delete=1, detail=none);
 
+CREATE VIRTUAL TABLE shows_by_title_vocab USING fts5vocab (shows_by_title, row);
+
+CREATE VIRTUAL TABLE shows_by_description USING FTS5 (description, content='', contentless_delete=1, detail=column);
+
+CREATE VIRTUAL TABLE shows_by_title_trigram USING FTS5 (title, tokenize='trigram', content='', contentless_delete=1);
+
 CREATE TABLE blobs (
     id INTEGER PRIMARY KEY AUTOINCREMENT,
+    frames BLOB NOT NULL,
     blob BLOB NOT NULL
 );
 
+CREATE TABLE sort_ranks (
+    id INTEGER PRIMARY KEY,
+    ranks BLOB NOT NULL
+);
+
+CREATE TABLE dictionaries (
+    id INTEGER PRIMARY KEY,
+    kind INTEGER NOT NULL,
+    dictionary BLOB NOT NULL
+);
+
 INSERT INTO sqlite_sequence (name, seq) VALUES ('shows', 0);
 INSERT INTO sqlite_sequence (name, seq) VALUES ('blobs', 0);
 
-PRAGMA user_version = 8;
+PRAGMA user_version = 22;
 
 COMMIT;
-"#,
+"#;
+
+pub fn open_connection(path: &Path) -> Fallible<Connection> {
+    let conn = Connection::open_with_flags(
+        path,
+        OpenFlags::default() | OpenFlags::SQLITE_OPEN_PRIVATE_CACHE,
     )?;
 
-    Ok((conn, true))
+    conn.pragma_update(None, "journal_mode", "WAL")?;
+    conn.pragma_update(None, "synchronous", "NORMAL")?;
+
+    Ok(conn)
+}
+
+// Read-only connections are pooled so that any number of threads can read concurrently,
+// each seeing its own snapshot of the database in WAL mode.
+pub struct ConnectionPool {
+    path: PathBuf,
+    conns: Mutex<Vec<Connection>>,
+}
+
+impl ConnectionPool {
+    pub fn new(path: &Path) -> Self {
+        Self {
+            path: path.to_owned(),
+            conns: Mutex::new(Vec::new()),
+        }
+    }
+
+    pub fn get(&self) -> Fallible<PooledConnection<'_>> {
+        let conn = self.conns.lock().unwrap().pop();
+
+        let conn = match conn {
+            Some(conn) => conn,
+            None => Connection::open_with_flags(
+                &self.path,
+                OpenFlags::SQLITE_OPEN_READ_ONLY
+                    | OpenFlags::SQLITE_OPEN_NO_MUTEX
+                    | OpenFlags::SQLITE_OPEN_PRIVATE_CACHE,
+            )?,
+        };
+
+        Ok(PooledConnection {
+            pool: self,
+            conn: Some(conn),
+        })
+    }
+}
+
+pub struct PooledConnection<'a> {
+    pool: &'a ConnectionPool,
+    conn: Option<Connection>,
+}
+
+impl Deref for PooledConnection<'_> {
+    type Target = Connection;
+
+    fn deref(&self) -> &Connection {
+        self.conn.as_ref().unwrap()
+    }
 }
 
-pub fn full_update(conn: &Connection, items: &Receiver<Item>) -> Fallible {
+impl DerefMut for PooledConnection<'_> {
+    fn deref_mut(&mut self) -> &mut Connection {
+        self.conn.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledConnection<'_> {
+    fn drop(&mut self) {
+        if let Some(conn) = self.conn.take() {
+            self.pool.conns.lock().unwrap().push(conn);
+        }
+    }
+}
+
+pub fn create_schema(path: &Path) -> Fallible<bool> {
+    create_dir_all(path.parent().unwrap())?;
+
+    let mut conn = open_connection(path)?;
+
+    let user_version: i32 = conn.pragma_query_value(None, "user_version", |row| row.get(0))?;
+
+    if user_version == 22 {
+        return Ok(false);
+    }
+
+    remove_file(path)?;
+
+    conn = open_connection(path)?;
+
+    conn.execute_batch(SCHEMA)?;
+
+    Ok(true)
+}
+
+pub fn full_update(
+    conn: &Connection,
+    items: &Receiver<Item>,
+    indexes: Indexes,
+    inserted: &AtomicU64,
+    cancelled: &AtomicBool,
+) -> Fallible {
     conn.execute_batch(
         r#"
+DELETE FROM dictionaries;
 DELETE FROM blobs;
 INSERT INTO shows_by_title (shows_by_title) VALUES ('delete-all');
+INSERT INTO shows_by_description (shows_by_description) VALUES ('delete-all');
+INSERT INTO shows_by_title_trigram (shows_by_title_trigram) VALUES ('delete-all');
 DELETE FROM shows;
 DELETE FROM topics;
 DELETE FROM channels;
 "#,
     )?;
 
-    update(conn, items, &mut |_, _, _| Ok(()))
+    let samples = items.iter().take(DICTIONARY_SAMPLES).collect::<Vec<_>>();
+
+    check_cancelled(cancelled)?;
+
+    let dicts = Dictionaries::train(conn, &samples)?;
+
+    update(
+        conn,
+        samples.into_iter().chain(items.iter()),
+        &dicts,
+        indexes,
+        inserted,
+        cancelled,
+        &mut |_, _, _| Ok(()),
+    )
 }
 
-pub fn partial_update(conn: &Connection, items: &Receiver<Item>) -> Fallible {
+pub fn partial_update(
+    conn: &Connection,
+    items: &Receiver<Item>,
+    inserted: &AtomicU64,
+    cancelled: &AtomicBool,
+) -> Fallible {
+    // Partial updates maintain exactly those optional indexes built by the last full update.
+    let indexes = populated_indexes(conn)?;
+
     let max_show_id: i64 = conn.query_row(
         "SELECT seq FROM sqlite_sequence WHERE name = 'shows'",
         [],
@@ -124,8 +264,8 @@ pub fn partial_update(conn: &Connection, items: &Receiver<Item>) -> Fallible {
     let mut select_shows = conn.prepare(
         r#"
 SELECT
-    text_blob_id,
-    text_offset,
+    title_blob_id,
+    title_offset,
     url_blob_id,
     url_offset,
     id
@@ -138,72 +278,111 @@ ORDER BY id
     )?;
 
     let mut delete_show = conn.prepare("DELETE FROM shows WHERE id = ?")?;
-    let mut delete_title = conn.prepare(
-        "INSERT INTO shows_by_title (shows_by_title, rowid, title) VALUES ('delete', ?, ?)",
-    )?;
-
-    let mut text_fetcher = BlobFetcher::new();
-    let mut url_fetcher = BlobFetcher::new();
-
-    update(conn, items, &mut |topic_id, title, url| {
-        let mut rows = select_shows.query(params![topic_id, max_show_id])?;
-
-        while let Some(row) = rows.next()? {
-            let mut texts = text_fetcher.fetch(conn, row.get(0)?, row.get(1)?)?;
-            if title.as_bytes() != texts.next().unwrap() {
-                continue;
+    let mut delete_title = conn.prepare("DELETE FROM shows_by_title WHERE rowid = ?")?;
+    let mut delete_description =
+        conn.prepare("DELETE FROM shows_by_description WHERE rowid = ?")?;
+    let mut delete_title_trigrams =
+        conn.prepare("DELETE FROM shows_by_title_trigram WHERE rowid = ?")?;
+
+    let fetcher = BlobFetcher::new(UPDATE_CACHE_LEN);
+
+    let dicts = Dictionaries::load(conn)?;
+
+    update(
+        conn,
+        items.iter(),
+        &dicts,
+        indexes,
+        inserted,
+        cancelled,
+        &mut |topic_id, title, url| {
+            let mut rows = select_shows.query(params![topic_id, max_show_id])?;
+
+            while let Some(row) = rows.next()? {
+                let (title_blob_id, title_offset) = (row.get(0)?, row.get(1)?);
+                let titles = fetcher.fetch(conn, once((title_blob_id, title_offset)))?;
+                if title.as_bytes() != titles.get(title_blob_id, title_offset)?.next().unwrap() {
+                    continue;
+                }
+
+                let (url_blob_id, url_offset) = (row.get(2)?, row.get(3)?);
+                let urls = fetcher.fetch(conn, once((url_blob_id, url_offset)))?;
+                if url.as_bytes() != urls.get(url_blob_id, url_offset)?.next().unwrap() {
+                    continue;
+                }
+
+                let id: i64 = row.get(4)?;
+
+                delete_show.execute(params![id])?;
+                delete_title.execute(params![id])?;
+                delete_description.execute(params![id])?;
+                delete_title_trigrams.execute(params![id])?;
+
+                break;
             }
 
-            let mut urls = url_fetcher.fetch(conn, row.get(2)?, row.get(3)?)?;
-            if url.as_bytes() != urls.next().unwrap() {
-                continue;
-            }
-
-            let id: i64 = row.get(4)?;
-
-            delete_show.execute(params![id])?;
-            delete_title.execute(params![id, title])?;
-
-            break;
-        }
-
-        Ok(())
-    })
+            Ok(())
+        },
+    )
 }
 
-fn update(
+fn update<I>(
     conn: &Connection,
-    items: &Receiver<Item>,
+    items: I,
+    dicts: &Dictionaries,
+    indexes: Indexes,
+    inserted: &AtomicU64,
+    cancelled: &AtomicBool,
     deleter: &mut dyn FnMut(i64, &str, &str) -> Fallible,
-) -> Fallible {
+) -> Fallible
+where
+    I: IntoIterator<Item = Item>,
+{
     let mut select_channel = conn.prepare("SELECT id FROM channels WHERE channel = ?")?;
-    let mut insert_channel = conn.prepare("INSERT INTO channels (channel) VALUES (?)")?;
+    let mut insert_channel =
+        conn.prepare("INSERT INTO channels (channel, channel_key) VALUES (?, ?)")?;
     let mut channel_id = 0;
 
     let mut select_topic =
         conn.prepare("SELECT id FROM topics WHERE topic = ? AND channel_id = ?")?;
-    let mut insert_topic = conn.prepare("INSERT INTO topics (topic, channel_id) VALUES (?, ?)")?;
+    let mut insert_topic =
+        conn.prepare("INSERT INTO topics (topic, topic_key, channel_id) VALUES (?, ?, ?)")?;
     let mut topic_id = 0;
 
     let mut insert_show = conn.prepare(
         r#"
 INSERT INTO shows (
     topic_id,
-    text_blob_id,
-    text_offset,
+    title_blob_id,
+    title_offset,
+    description_blob_id,
+    description_offset,
     url_blob_id,
     url_offset,
     url_mask,
     date,
     time,
     duration
-) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
 "#,
     )?;
 
     let mut insert_title =
         conn.prepare("INSERT INTO shows_by_title (rowid, title) VALUES (?,?)")?;
 
+    // Indexing descriptions is optional as it roughly doubles the size of the database.
+    let mut insert_description = if indexes.descriptions {
+        Some(conn.prepare("INSERT INTO shows_by_description (rowid, description) VALUES (?,?)")?)
+    } else {
+        None
+    };
+
+    let mut insert_title_trigrams = if indexes.title_trigrams {
+        Some(conn.prepare("INSERT INTO shows_by_title_trigram (rowid, title) VALUES (?,?)")?)
+    } else {
+        None
+    };
+
     let mut next_blob_id = {
         let mut update_blob_id =
             conn.prepare("UPDATE sqlite_sequence SET seq = seq + 1 WHERE name = 'blobs'")?;
@@ -217,22 +396,27 @@ INSERT INTO shows (
     };
 
     let mut insert_blob = {
-        let mut stmt = conn.prepare("INSERT INTO blobs (id, blob) VALUES (?, ?)")?;
+        let mut stmt = conn.prepare("INSERT INTO blobs (id, frames, blob) VALUES (?, ?, ?)")?;
 
-        move |id: i64, blob: &[u8]| {
-            stmt.execute(params![id, blob])?;
+        move |id: i64, blob: &[u8], frames: &[u8]| {
+            stmt.execute(params![id, frames, blob])?;
 
             Ok(())
         }
     };
 
-    let mut text_compr = BackgroundCompressor::new();
-    let mut text_blob_id = next_blob_id()?;
+    let mut title_compr = BackgroundCompressor::new(dicts.title.as_deref());
+    let mut title_blob_id = next_blob_id()?;
+
+    let mut description_compr = BackgroundCompressor::new(dicts.description.as_deref());
+    let mut description_blob_id = next_blob_id()?;
 
-    let mut url_compr = BackgroundCompressor::new();
+    let mut url_compr = BackgroundCompressor::new(dicts.url.as_deref());
     let mut url_blob_id = next_blob_id()?;
 
-    for item in items.iter() {
+    for item in items {
+        check_cancelled(cancelled)?;
+
         if !item.topic.is_empty() {
             if !item.channel.is_empty() {
                 channel_id = get_or_insert_channel(
@@ -257,18 +441,29 @@ INSERT INTO shows (
         insert_show_and_title(
             conn,
             topic_id,
-            text_blob_id,
-            &mut text_compr,
+            title_blob_id,
+            &mut title_compr,
+            description_blob_id,
+            &mut description_compr,
             url_blob_id,
             &mut url_compr,
             &mut insert_show,
             &mut insert_title,
+            insert_description.as_mut(),
+            insert_title_trigrams.as_mut(),
             &item,
         )?;
 
-        if text_compr.len() >= TEXT_BLOB_LEN {
-            let blob_id = replace(&mut text_blob_id, next_blob_id()?);
-            text_compr.rotate(blob_id, &mut insert_blob)?;
+        inserted.fetch_add(1, Ordering::Relaxed);
+
+        if title_compr.len() >= TITLE_BLOB_LEN {
+            let blob_id = replace(&mut title_blob_id, next_blob_id()?);
+            title_compr.rotate(blob_id, &mut insert_blob)?;
+        }
+
+        if description_compr.len() >= DESCRIPTION_BLOB_LEN {
+            let blob_id = replace(&mut description_blob_id, next_blob_id()?);
+            description_compr.rotate(blob_id, &mut insert_blob)?;
         }
 
         if url_compr.len() >= URL_BLOB_LEN {
@@ -277,26 +472,212 @@ INSERT INTO shows (
         }
     }
 
-    text_compr.finish(text_blob_id, &mut insert_blob)?;
+    title_compr.finish(title_blob_id, &mut insert_blob)?;
+    description_compr.finish(description_blob_id, &mut insert_blob)?;
     url_compr.finish(url_blob_id, &mut insert_blob)?;
 
+    // A cancelled download ends the items early, so do not spend time ranking an incomplete list.
+    check_cancelled(cancelled)?;
+
+    update_ranks(conn)
+}
+
+fn check_cancelled(cancelled: &AtomicBool) -> Fallible {
+    if cancelled.load(Ordering::Relaxed) {
+        return Err("Update cancelled".into());
+    }
+
     Ok(())
 }
 
+pub fn populated_indexes(conn: &Connection) -> Fallible<Indexes> {
+    Ok(Indexes {
+        descriptions: is_populated(conn, "shows_by_description")?,
+        title_trigrams: is_populated(conn, "shows_by_title_trigram")?,
+    })
+}
+
+pub fn is_populated(conn: &Connection, table: &str) -> Fallible<bool> {
+    let populated = conn.query_row(
+        &format!("SELECT EXISTS (SELECT 1 FROM {table})"),
+        [],
+        |row| row.get(0),
+    )?;
+
+    Ok(populated)
+}
+
+#[derive(Clone, Copy)]
+pub enum SortRanks {
+    ChannelAscending,
+    ChannelDescending,
+    Topic,
+    Title,
+    Date,
+    Time,
+    Duration,
+}
+
+pub const SORT_RANKS: usize = 7;
+
+// Ranks are stored in the order of show IDs, one little-endian integer per show.
+fn update_ranks(conn: &Connection) -> Fallible {
+    let channel_ranks = rank_names(conn, "SELECT id, channel FROM channels")?;
+    let topic_ranks = rank_names(conn, "SELECT id, topic FROM topics")?;
+
+    let mut stmt = conn.prepare(
+        r#"
+SELECT
+    topics.channel_id,
+    shows.topic_id,
+    shows.title_blob_id,
+    shows.title_offset,
+    shows.date,
+    shows.time,
+    shows.duration
+FROM topics, shows
+WHERE topics.id = shows.topic_id
+ORDER BY shows.id
+"#,
+    )?;
+
+    let mut rows = stmt.query([])?;
+
+    let mut channels = Vec::new();
+    let mut topics = Vec::new();
+    let mut titles = Vec::new();
+    let mut dates = Vec::new();
+    let mut times = Vec::new();
+    let mut durations = Vec::new();
+
+    // Shows are stored in the order of their title blobs, so each frame is decompressed only once.
+    let fetcher = BlobFetcher::new(UPDATE_CACHE_LEN);
+
+    while let Some(row) = rows.next()? {
+        channels.push(channel_ranks[&row.get::<_, i64>(0)?]);
+        topics.push(topic_ranks[&row.get::<_, i64>(1)?]);
+
+        let (title_blob_id, title_offset) = (row.get(2)?, row.get(3)?);
+        let blobs = fetcher.fetch(conn, once((title_blob_id, title_offset)))?;
+        let title = blobs.get(title_blob_id, title_offset)?.next().unwrap();
+        titles.push(collation_key(from_utf8(title)?));
+
+        dates.push(row.get::<_, i64>(4)?);
+        times.push(row.get::<_, u32>(5)?);
+        durations.push(row.get::<_, u32>(6)?);
+    }
+
+    let len = channels.len();
+
+    let mut stmt = conn.prepare("INSERT OR REPLACE INTO sort_ranks (id, ranks) VALUES (?, ?)")?;
+
+    let mut write_ranks = |sort_ranks: SortRanks, ranks: Vec<u32>| -> Fallible {
+        let ranks = ranks
+            .iter()
+            .flat_map(|rank| rank.to_le_bytes())
+            .collect::<Vec<_>>();
+
+        stmt.execute(params![sort_ranks as i64, ranks])?;
+
+        Ok(())
+    };
+
+    write_ranks(
+        SortRanks::ChannelAscending,
+        ranks_by(len, |row| {
+            (
+                channels[row],
+                topics[row],
+                Reverse(dates[row]),
+                Reverse(times[row]),
+            )
+        }),
+    )?;
+
+    write_ranks(
+        SortRanks::ChannelDescending,
+        ranks_by(len, |row| {
+            (
+                Reverse(channels[row]),
+                Reverse(topics[row]),
+                Reverse(dates[row]),
+                Reverse(times[row]),
+            )
+        }),
+    )?;
+
+    write_ranks(SortRanks::Topic, ranks_by(len, |row| topics[row]))?;
+    write_ranks(SortRanks::Title, ranks_by(len, |row| &titles[row]))?;
+    write_ranks(
+        SortRanks::Date,
+        ranks_by(len, |row| (dates[row], times[row])),
+    )?;
+    write_ranks(SortRanks::Time, ranks_by(len, |row| times[row]))?;
+    write_ranks(SortRanks::Duration, ranks_by(len, |row| durations[row]))?;
+
+    Ok(())
+}
+
+fn rank_names(conn: &Connection, sql: &str) -> Fallible<HashMap<i64, u32>> {
+    let mut stmt = conn.prepare(sql)?;
+    let mut rows = stmt.query([])?;
+
+    let mut keys = Vec::new();
+
+    while let Some(row) = rows.next()? {
+        keys.push((collation_key(row.get_ref_unwrap(1).as_str()?), row.get(0)?));
+    }
+
+    keys.par_sort_unstable();
+
+    Ok(keys
+        .into_iter()
+        .enumerate()
+        .map(|(rank, (_, id))| (id, rank as u32))
+        .collect())
+}
+
+// Ties are broken by show ID so that every sort order is a permutation.
+fn ranks_by<K, F>(len: usize, key: F) -> Vec<u32>
+where
+    K: Ord,
+    F: Fn(usize) -> K + Sync,
+{
+    let mut rows = (0..len).collect::<Vec<_>>();
+
+    rows.par_sort_unstable_by(|&lhs, &rhs| key(lhs).cmp(&key(rhs)).then(lhs.cmp(&rhs)));
+
+    let mut ranks = vec![0; len];
+
+    for (rank, row) in rows.into_iter().enumerate() {
+        ranks[row] = rank as u32;
+    }
+
+    ranks
+}
+
 #[allow(clippy::too_many_arguments)]
 fn insert_show_and_title(
     conn: &Connection,
     topic_id: i64,
-    text_blob_id: i64,
-    text_compr: &mut BackgroundCompressor<i64>,
+    title_blob_id: i64,
+    title_compr: &mut BackgroundCompressor<i64>,
+    description_blob_id: i64,
+    description_compr: &mut BackgroundCompressor<i64>,
     url_blob_id: i64,
     url_compr: &mut BackgroundCompressor<i64>,
     insert_show: &mut Statement,
     insert_title: &mut Statement,
+    insert_description: Option<&mut Statement>,
+    insert_title_trigrams: Option<&mut Statement>,
     item: &Item,
 ) -> Fallible {
-    let text_offset = text_compr.push(&item.title)?;
-    text_compr.push(&item.description)?;
+    title_compr.begin_record();
+    description_compr.begin_record();
+    url_compr.begin_record();
+
+    let title_offset = title_compr.push(&item.title)?;
+    let description_offset = description_compr.push(&item.description)?;
 
     let url_offset = url_compr.push(&item.url)?;
     let mut url_mask = 0;
@@ -315,8 +696,10 @@ fn insert_show_and_title(
 
     insert_show.execute(params![
         topic_id,
-        text_blob_id,
-        text_offset,
+        title_blob_id,
+        title_offset,
+        description_blob_id,
+        description_offset,
         url_blob_id,
         url_offset,
         url_mask,
@@ -325,7 +708,22 @@ fn insert_show_and_title(
         seconds_from_midnight(item.duration),
     ])?;
 
-    insert_title.execute(params![conn.last_insert_rowid(), item.title])?;
+    let id = conn.last_insert_rowid();
+
+    // The title indexes are contentless so they can store the folded titles.
+    let title = index_title(&item.title);
+
+    insert_title.execute(params![id, title])?;
+
+    if let Some(insert_title_trigrams) = insert_title_trigrams {
+        insert_title_trigrams.execute(params![id, title])?;
+    }
+
+    if let Some(insert_description) = insert_description {
+        if !item.description.is_empty() {
+            insert_description.execute(params![id, item.description])?;
+        }
+    }
 
     Ok(())
 }
@@ -344,7 +742,7 @@ fn get_or_insert_topic(
     match id {
         Some(id) => Ok(id),
         None => {
-            insert.execute(params![topic, channel_id])?;
+            insert.execute(params![topic, search_key(topic), channel_id])?;
             Ok(conn.last_insert_rowid())
         }
     }
@@ -363,56 +761,351 @@ fn get_or_insert_channel(
     match id {
         Some(id) => Ok(id),
         None => {
-            insert.execute(params![channel])?;
+            insert.execute(params![channel, search_key(channel)])?;
             Ok(conn.last_insert_rowid())
         }
     }
 }
 
+#[derive(Default)]
+struct Dictionaries {
+    title: Option<Vec<u8>>,
+    description: Option<Vec<u8>>,
+    url: Option<Vec<u8>>,
+}
+
+impl Dictionaries {
+    fn train(conn: &Connection, samples: &[Item]) -> Fallible<Self> {
+        let mut title_trainer = Trainer::new();
+        let mut description_trainer = Trainer::new();
+        let mut url_trainer = Trainer::new();
+
+        for item in samples {
+            title_trainer.push(once(item.title.as_str()));
+            description_trainer.push(once(item.description.as_str()));
+
+            url_trainer.push(
+                once(item.url.as_str())
+                    .chain(item.url_small.as_deref())
+                    .chain(item.url_large.as_deref())
+                    .chain(once(item.website.as_str())),
+            );
+        }
+
+        let (title, (description, url)) = join(
+            || title_trainer.train(),
+            || join(|| description_trainer.train(), || url_trainer.train()),
+        );
+
+        let mut stmt =
+            conn.prepare("INSERT INTO dictionaries (id, kind, dictionary) VALUES (?, ?, ?)")?;
+
+        let mut dicts = Self::default();
+
+        if let Some((id, dict)) = title {
+            stmt.execute(params![id, TITLE_DICTIONARY, dict])?;
+            dicts.title = Some(dict);
+        }
+
+        if let Some((id, dict)) = description {
+            stmt.execute(params![id, DESCRIPTION_DICTIONARY, dict])?;
+            dicts.description = Some(dict);
+        }
+
+        if let Some((id, dict)) = url {
+            stmt.execute(params![id, URL_DICTIONARY, dict])?;
+            dicts.url = Some(dict);
+        }
+
+        Ok(dicts)
+    }
+
+    fn load(conn: &Connection) -> Fallible<Self> {
+        let mut stmt = conn.prepare("SELECT kind, dictionary FROM dictionaries")?;
+        let mut rows = stmt.query([])?;
+
+        let mut dicts = Self::default();
+
+        while let Some(row) = rows.next()? {
+            match row.get(0)? {
+                TITLE_DICTIONARY => dicts.title = Some(row.get(1)?),
+                DESCRIPTION_DICTIONARY => dicts.description = Some(row.get(1)?),
+                URL_DICTIONARY => dicts.url = Some(row.get(1)?),
+                kind => return Err(format!("Unknown dictionary kind {kind}").into()),
+            }
+        }
+
+        Ok(dicts)
+    }
+}
+
+// The cache is shared by all threads, but frames are read and decompressed without holding its lock.
 pub struct BlobFetcher {
-    blob_id: Option<i64>,
-    decompr: Decompressor,
+    capacity: usize,
+    cache: Mutex<FrameCache>,
+}
+
+// Frames are indexed by their BLOB and start offset and evicted in the order of their last use.
+#[derive(Default)]
+struct FrameCache {
+    len: usize,
+    frames: BTreeMap<(i64, u32), (Frame, u64)>,
+    last_used: BTreeMap<u64, (i64, u32)>,
+    clock: u64,
+    dicts: HashMap<u32, Arc<Dictionary>>,
+    hits: u64,
+    misses: u64,
 }
 
 impl BlobFetcher {
-    pub fn new() -> Self {
+    pub fn new(capacity: usize) -> Self {
         Self {
-            blob_id: None,
-            decompr: Decompressor::new(),
+            capacity,
+            cache: Mutex::new(FrameCache::default()),
         }
     }
 
-    pub fn fetch(
-        &mut self,
-        conn: &Connection,
-        blob_id: i64,
-        offset: u32,
-    ) -> Fallible<impl Iterator<Item = &[u8]>> {
-        if self.blob_id != Some(blob_id) {
-            let mut stmt = conn.prepare_cached("SELECT blob FROM blobs WHERE id = ?")?;
-            let mut rows = stmt.query(params![blob_id])?;
-            let row = rows
-                .next()?
+    // Frames found in and missing from the cache so far, e.g. to tune its capacity.
+    pub fn stats(&self) -> (u64, u64) {
+        let cache = self.cache.lock().unwrap();
+
+        (cache.hits, cache.misses)
+    }
+
+    // Dictionaries are identified only by the ID stored in each frame, which a newly trained one might reuse.
+    pub fn clear(&self) {
+        let mut cache = self.cache.lock().unwrap();
+
+        cache.len = 0;
+        cache.frames.clear();
+        cache.last_used.clear();
+        cache.dicts.clear();
+    }
+
+    // Only the frames containing the given offsets are read and decompressed.
+    pub fn fetch<I>(&self, conn: &Connection, offsets: I) -> Fallible<Blobs>
+    where
+        I: IntoIterator<Item = (i64, u32)>,
+    {
+        let mut stmt = conn.prepare_cached("SELECT frames FROM blobs WHERE id = ?")?;
+
+        let mut frames = Vec::new();
+        let mut missing = Vec::new();
+
+        for (blob_id, offset) in offsets {
+            if frames
+                .iter()
+                .any(|frame: &Frame| frame.contains(blob_id, offset))
+                || missing
+                    .iter()
+                    .any(|(id, range, _, _, _): &(i64, Range<u32>, _, _, _)| {
+                        *id == blob_id && range.contains(&offset)
+                    })
+            {
+                continue;
+            }
+
+            if let Some(frame) = self.cache.lock().unwrap().get(blob_id, offset) {
+                frames.push(frame);
+                continue;
+            }
+
+            let index = stmt
+                .query_row(params![blob_id], |row| row.get::<_, Vec<u8>>(0))
+                .optional()?
                 .ok_or_else(|| format!("No BLOB with ID {blob_id}"))?;
 
-            let blob = row.get_ref_unwrap(0).as_blob()?;
+            let (range, compr_range) = find_frame(&index, offset)
+                .ok_or_else(|| format!("No frame at offset {offset} in BLOB with ID {blob_id}"))?;
+
+            let blob = conn.blob_open(MAIN_DB, "blobs", "blob", blob_id, true)?;
+
+            let mut compr_buf = vec![0; compr_range.len()];
+            blob.read_at_exact(&mut compr_buf, compr_range.start)?;
+
+            let dict = match Dictionary::id(&compr_buf) {
+                Some(dict_id) => Some(self.dictionary(conn, dict_id)?),
+                None => None,
+            };
 
-            self.decompr.decompress(blob)?;
-            self.blob_id = Some(blob_id);
+            missing.push((blob_id, range, compr_buf, dict, None));
         }
 
-        let mut buf = &self.decompr.buf()[offset as usize..];
+        scope(|scope| {
+            for (_, _, compr_buf, dict, buf) in &mut missing {
+                scope.spawn(move |_| {
+                    *buf = Some(decompress(compr_buf, dict.as_deref()));
+                });
+            }
+        });
+
+        let mut cache = self.cache.lock().unwrap();
+
+        for (blob_id, range, _, _, buf) in missing {
+            let frame = Frame {
+                blob_id,
+                start: range.start,
+                buf: Arc::new(buf.unwrap()?),
+            };
+
+            cache.insert(frame.clone(), self.capacity);
+            frames.push(frame);
+        }
+
+        Ok(Blobs(frames))
+    }
+
+    fn dictionary(&self, conn: &Connection, dict_id: u32) -> Fallible<Arc<Dictionary>> {
+        if let Some(dict) = self.cache.lock().unwrap().dicts.get(&dict_id) {
+            return Ok(dict.clone());
+        }
 
-        Ok(from_fn(move || {
-            memchr(b'\0', buf).map(|pos| {
-                let val = &buf[..pos];
-                buf = &buf[pos + 1..];
-                val
-            })
-        }))
+        let dict = conn
+            .query_row(
+                "SELECT dictionary FROM dictionaries WHERE id = ?",
+                [&dict_id],
+                |row| row.get::<_, Vec<u8>>(0),
+            )
+            .optional()?
+            .ok_or_else(|| format!("No dictionary with ID {dict_id}"))?;
+
+        let dict = Arc::new(Dictionary::new(&dict));
+
+        Ok(self
+            .cache
+            .lock()
+            .unwrap()
+            .dicts
+            .entry(dict_id)
+            .or_insert(dict)
+            .clone())
     }
 }
 
+impl FrameCache {
+    fn get(&mut self, blob_id: i64, offset: u32) -> Option<Frame> {
+        let (&key, (frame, last_used)) = self.frames.range_mut(..=(blob_id, offset)).next_back()?;
+
+        if !frame.contains(blob_id, offset) {
+            return None;
+        }
+
+        self.clock += 1;
+        self.last_used.remove(last_used);
+        self.last_used.insert(self.clock, key);
+        *last_used = self.clock;
+
+        self.hits += 1;
+
+        Some(frame.clone())
+    }
+
+    // Evicts the least recently used frames until the decompressed size fits into the capacity.
+    fn insert(&mut self, frame: Frame, capacity: usize) {
+        self.misses += 1;
+
+        self.clock += 1;
+        let key = (frame.blob_id, frame.start);
+
+        self.len += frame.buf.len();
+        self.last_used.insert(self.clock, key);
+
+        // Concurrent fetches might have decompressed the same frame.
+        if let Some((frame, last_used)) = self.frames.insert(key, (frame, self.clock)) {
+            self.len -= frame.buf.len();
+            self.last_used.remove(&last_used);
+        }
+
+        while self.len > capacity {
+            let (&last_used, &key) = match self.last_used.iter().next() {
+                Some(entry) => entry,
+                None => break,
+            };
+
+            self.last_used.remove(&last_used);
+
+            let (frame, _) = self.frames.remove(&key).unwrap();
+            self.len -= frame.buf.len();
+        }
+    }
+}
+
+#[derive(Clone)]
+struct Frame {
+    blob_id: i64,
+    start: u32,
+    buf: Arc<Vec<u8>>,
+}
+
+impl Frame {
+    fn contains(&self, blob_id: i64, offset: u32) -> bool {
+        self.blob_id == blob_id
+            && offset >= self.start
+            && ((offset - self.start) as usize) < self.buf.len()
+    }
+}
+
+pub struct Blobs(Vec<Frame>);
+
+impl Blobs {
+    pub fn get(&self, blob_id: i64, offset: u32) -> Fallible<impl Iterator<Item = &[u8]>> {
+        let frame = self
+            .0
+            .iter()
+            .find(|frame| frame.contains(blob_id, offset))
+            .ok_or_else(|| format!("No frame at offset {offset} in BLOB with ID {blob_id}"))?;
+
+        Ok(split(&frame.buf, offset - frame.start))
+    }
+}
+
+fn split(buf: &[u8], offset: u32) -> impl Iterator<Item = &[u8]> {
+    let mut buf = &buf[offset as usize..];
+
+    from_fn(move || {
+        memchr(b'\0', buf).map(|pos| {
+            let val = &buf[..pos];
+            buf = &buf[pos + 1..];
+            val
+        })
+    })
+}
+
 fn seconds_from_midnight(time: Time) -> i64 {
     (time - Time::MIDNIGHT).whole_seconds()
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn frame(blob_id: i64, start: u32, len: usize) -> Frame {
+        Frame {
+            blob_id,
+            start,
+            buf: Arc::new(vec![0; len]),
+        }
+    }
+
+    #[test]
+    fn evicts_least_recently_used_frames() {
+        let mut cache = FrameCache::default();
+
+        cache.insert(frame(1, 0, 10), 30);
+        cache.insert(frame(1, 10, 10), 30);
+        cache.insert(frame(2, 0, 10), 30);
+
+        assert_eq!(cache.get(1, 5).unwrap().start, 0);
+        assert!(cache.get(1, 25).is_none());
+        assert!(cache.get(3, 0).is_none());
+
+        cache.insert(frame(2, 10, 10), 30);
+
+        assert_eq!(cache.len, 30);
+        assert!(cache.get(1, 15).is_none());
+        assert!(cache.get(1, 0).is_some());
+        assert!(cache.get(2, 19).is_some());
+
+        assert_eq!((cache.hits, cache.misses), (3, 4));
+    }
+}
@@ -0,0 +1,85 @@
+use std::io::{BufRead, Cursor, Read};
+
+use liblzma::{bufread::XzDecoder, stream::MtStreamBuilder};
+use rayon_core::current_num_threads;
+use zstd::stream::read::Decoder as ZstdDecoder;
+
+use super::Fallible;
+
+const XZ_MAGIC: &[u8] = b"\xFD7zXZ\x00";
+const ZSTD_MAGIC: &[u8] = b"\x28\xB5\x2F\xFD";
+
+// Memory the multi-threaded xz decoder may use before falling back to a single thread.
+const XZ_MEMLIMIT_THREADING: u64 = 512 * 1024 * 1024;
+
+// Distributors may use long distance matching, so allow the maximum window size.
+const ZSTD_WINDOW_LOG_MAX: u32 = 31;
+
+// The compression format is sniffed from the magic bytes, so that both list URLs can point to either format.
+pub fn decoder<'a, R: 'a + BufRead + Send>(mut reader: R) -> Fallible<Box<dyn 'a + Read + Send>> {
+    // A single fill of the buffer might yield fewer bytes than the magic, e.g. if the body arrives in small chunks.
+    let mut magic = Vec::with_capacity(XZ_MAGIC.len());
+    reader
+        .by_ref()
+        .take(XZ_MAGIC.len() as u64)
+        .read_to_end(&mut magic)?;
+
+    let is_zstd = magic.starts_with(ZSTD_MAGIC);
+    let is_xz = magic.starts_with(XZ_MAGIC);
+
+    let reader = Cursor::new(magic).chain(reader);
+
+    if is_zstd {
+        let mut decoder = ZstdDecoder::with_buffer(reader)?;
+        decoder.window_log_max(ZSTD_WINDOW_LOG_MAX)?;
+
+        Ok(Box::new(decoder))
+    } else if is_xz {
+        // Blocks are decoded in parallel if the stream was compressed into multiple blocks.
+        let stream = MtStreamBuilder::new()
+            .threads(current_num_threads() as u32)
+            .memlimit_threading(XZ_MEMLIMIT_THREADING)
+            .memlimit_stop(u64::MAX)
+            .decoder()?;
+
+        Ok(Box::new(XzDecoder::new_stream(reader, stream)))
+    } else {
+        Err("Unknown compression format".into())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use std::io::BufReader;
+
+    // Yields at most one byte per read, like a body arriving in small chunks.
+    struct Trickle<'a>(&'a [u8]);
+
+    impl Read for Trickle<'_> {
+        fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+            let len = buf.len().min(self.0.len()).min(1);
+            buf[..len].copy_from_slice(&self.0[..len]);
+            self.0 = &self.0[len..];
+            Ok(len)
+        }
+    }
+
+    #[test]
+    fn sniffs_magic_across_short_reads() {
+        let compressed = zstd::encode_all(&b"foobar"[..], 0).unwrap();
+
+        let mut reader = decoder(BufReader::new(Trickle(&compressed))).unwrap();
+
+        let mut decompressed = Vec::new();
+        reader.read_to_end(&mut decompressed).unwrap();
+
+        assert_eq!(decompressed, b"foobar");
+    }
+
+    #[test]
+    fn rejects_unknown_format() {
+        assert!(decoder(BufReader::new(Trickle(b"foo"))).is_err());
+    }
+}
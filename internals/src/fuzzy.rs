@@ -0,0 +1,209 @@
+use rusqlite::Connection;
+
+use super::Fallible;
+
+const MAX_CANDIDATES: usize = 16;
+
+// How many terms are compared between checks whether the query is still current.
+const CANCEL_CHECK_INTERVAL: usize = 4096;
+
+pub struct Vocabulary {
+    terms: Vec<String>,
+}
+
+impl Vocabulary {
+    pub fn load(conn: &Connection) -> Fallible<Self> {
+        let mut stmt = conn.prepare("SELECT term FROM shows_by_title_vocab")?;
+
+        let terms = stmt
+            .query_map([], |row| row.get(0))?
+            .collect::<Result<_, _>>()?;
+
+        Ok(Self { terms })
+    }
+
+    // The closest terms within the edit distance allowed for the given token, closest first.
+    // The last token of a query is still being typed, so it is compared to prefixes of the terms.
+    // Gives up with `None` as soon as the query is cancelled.
+    pub fn similar(
+        &self,
+        token: &str,
+        prefix: bool,
+        is_cancelled: &dyn Fn() -> bool,
+    ) -> Option<Vec<(&str, u32)>> {
+        let token = token.chars().collect::<Vec<_>>();
+
+        let max_distance = match token.len() {
+            0..=2 => return Some(Vec::new()),
+            3..=5 => 1,
+            _ => 2,
+        };
+
+        let mut row = Vec::with_capacity(token.len() + 1);
+        let mut candidates = Vec::new();
+
+        for (pos, term) in self.terms.iter().enumerate() {
+            if pos % CANCEL_CHECK_INTERVAL == 0 && is_cancelled() {
+                return None;
+            }
+
+            if let Some(distance) = edit_distance(&token, term, max_distance, prefix, &mut row) {
+                candidates.push((term.as_str(), distance));
+            }
+        }
+
+        candidates.sort_unstable_by_key(|&(term, distance)| (distance, term.len()));
+        candidates.truncate(MAX_CANDIDATES);
+
+        Some(candidates)
+    }
+}
+
+// Computes the Levenshtein distance one column per character of the term,
+// giving up as soon as every entry of the current column exceeds the maximum distance.
+fn edit_distance(
+    token: &[char],
+    term: &str,
+    max_distance: u32,
+    prefix: bool,
+    row: &mut Vec<u32>,
+) -> Option<u32> {
+    row.clear();
+    row.extend(0..=token.len() as u32);
+
+    let mut best = if prefix { row[token.len()] } else { u32::MAX };
+
+    for c in term.chars() {
+        let mut diagonal = row[0];
+        row[0] += 1;
+
+        let mut min = row[0];
+
+        for pos in 1..=token.len() {
+            let above = row[pos];
+            let cost = if token[pos - 1] == c { 0 } else { 1 };
+
+            row[pos] = (diagonal + cost).min(above + 1).min(row[pos - 1] + 1);
+
+            diagonal = above;
+            min = min.min(row[pos]);
+        }
+
+        if prefix {
+            best = best.min(row[token.len()]);
+        }
+
+        if min > max_distance {
+            break;
+        }
+    }
+
+    if !prefix {
+        best = row[token.len()];
+    }
+
+    if best <= max_distance {
+        Some(best)
+    } else {
+        None
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn distance(token: &str, term: &str, prefix: bool) -> Option<u32> {
+        let token = token.chars().collect::<Vec<_>>();
+
+        edit_distance(&token, term, 2, prefix, &mut Vec::new())
+    }
+
+    #[test]
+    fn bounded_edit_distance() {
+        assert_eq!(distance("tatort", "tatort", false), Some(0));
+        assert_eq!(distance("tatrot", "tatort", false), Some(2));
+        assert_eq!(distance("tatot", "tatort", false), Some(1));
+        assert_eq!(distance("tagesschau", "tatort", false), None);
+
+        assert_eq!(distance("tato", "tatort", false), Some(2));
+        assert_eq!(distance("tato", "tatort", true), Some(0));
+        assert_eq!(distance("tsto", "tatortreiniger", true), Some(1));
+    }
+
+    #[test]
+    fn closest_terms_first() {
+        let vocabulary = Vocabulary {
+            terms: vec!["tatort".into(), "tator".into(), "tagesschau".into()],
+        };
+
+        assert_eq!(
+            vocabulary.similar("tatorr", false, &|| false).unwrap(),
+            [("tator", 1), ("tatort", 1)]
+        );
+        assert_eq!(vocabulary.similar("tg", true, &|| false).unwrap(), []);
+        assert_eq!(vocabulary.similar("tatorr", false, &|| true), None);
+    }
+
+    // Run using `FILMLISTE=/path/to/Filmliste-akt.xz cargo test --release -- --ignored --nocapture similar_throughput`.
+    // This measures only the scan of the vocabulary, not the look-up of the candidates in the title index.
+    #[test]
+    #[ignore]
+    fn similar_throughput() {
+        use std::collections::BTreeSet;
+        use std::fs::File;
+        use std::io::BufReader;
+        use std::sync::atomic::AtomicU64;
+        use std::time::Instant;
+
+        use crate::collation::index_title;
+        use crate::decoder::decoder;
+        use crate::parser::parse;
+
+        let path = std::env::var_os("FILMLISTE").expect("FILMLISTE not set");
+
+        let (sender, receiver) = std::sync::mpsc::sync_channel(128);
+
+        let parser = std::thread::spawn(move || {
+            let mut reader = decoder(BufReader::new(File::open(path).unwrap())).unwrap();
+            parse(&mut reader, sender, &AtomicU64::new(0))
+        });
+
+        let mut terms = BTreeSet::new();
+
+        for item in receiver {
+            let title = index_title(&item.title);
+
+            for token in title.split(|c: char| !c.is_alphanumeric()) {
+                if !token.is_empty() && !terms.contains(token) {
+                    terms.insert(token.to_owned());
+                }
+            }
+        }
+
+        parser.join().unwrap().unwrap();
+
+        let vocabulary = Vocabulary {
+            terms: terms.into_iter().collect(),
+        };
+
+        for token in [
+            "tatrot",
+            "tagesschua",
+            "dokumentaton",
+            "nachrichen",
+            "sportschau",
+        ] {
+            let start = Instant::now();
+
+            let candidates = vocabulary.similar(token, true, &|| false).unwrap();
+
+            println!(
+                "{token}: {} candidates out of {} terms in {:.1} ms",
+                candidates.len(),
+                vocabulary.terms.len(),
+                start.elapsed().as_secs_f64() * 1e3
+            );
+        }
+    }
+}
@@ -1,8 +1,15 @@
 #![allow(clippy::missing_safety_doc)]
 
+mod collation;
 mod compressor;
 mod database;
+mod decoder;
+mod fuzzy;
+mod metadata;
 mod parser;
+mod progress;
+mod query;
+mod scanner;
 
 use std::error::Error;
 use std::ffi::{CStr, CString, OsStr};
@@ -12,110 +19,238 @@ use std::os::{
 };
 use std::path::{Path, PathBuf};
 use std::ptr::{null, null_mut};
-use std::slice::from_raw_parts;
+use std::slice::{from_raw_parts, from_raw_parts_mut};
 use std::str::from_utf8_unchecked;
-use std::sync::mpsc::{sync_channel, Receiver};
-use std::thread::spawn;
-
-use rusqlite::{Connection, ToSql};
-use xz2::bufread::XzDecoder;
-use zeptohttpc::{http::Request, RequestBuilderExt, RequestExt};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::mpsc::{channel, sync_channel, Receiver, RecvTimeoutError};
+use std::sync::Arc;
+use std::thread::{scope, spawn, JoinHandle};
+use std::time::Duration;
+
+use rusqlite::{params, Connection, OptionalExtension};
+use zeptohttpc::{
+    http::{header::CONTENT_LENGTH, Request},
+    Options, RequestBuilderExt, RequestExt,
+};
 
+use self::collation::{prefix_end, search_key};
 use self::database::{
-    create_schema, full_update, open_connection, partial_update, BlobFetcher, URL_LARGE, URL_SMALL,
+    create_schema, full_update, open_connection, partial_update, populated_indexes, BlobFetcher,
+    ConnectionPool, URL_LARGE, URL_SMALL,
 };
+use self::decoder::decoder;
 use self::parser::{parse, Item};
+use self::progress::{Cancellable, Counted, Progress, ProgressData};
+use self::query::{Outcome, Query, QueryWorker};
 
 pub type Fallible<T = ()> = Result<T, Box<dyn Error + Send + Sync>>;
 
+const PROGRESS_INTERVAL: Duration = Duration::from_millis(250);
+
+// Upper bound on how long cancelling an update can take while the download is stalled.
+const READ_TIMEOUT: Duration = Duration::from_secs(5);
+
 #[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq)]
 pub enum SortColumn {
     Channel,
     Topic,
+    Title,
     Date,
     Time,
     Duration,
+    Relevance,
 }
 
 #[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq)]
 pub enum SortOrder {
     Ascending,
     Descending,
 }
 
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct Indexes {
+    pub descriptions: bool,
+    pub title_trigrams: bool,
+}
+
+// Dropping the handle does not cancel the update, but waits for it to finish.
+pub struct UpdateHandle {
+    cancelled: Arc<AtomicBool>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl Drop for UpdateHandle {
+    fn drop(&mut self) {
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
 pub struct Internals {
     path: PathBuf,
-    conn: Connection,
-    text_fetcher: BlobFetcher,
-    url_fetcher: BlobFetcher,
+    pool: ConnectionPool,
+    query_worker: QueryWorker,
+    fetcher: Arc<BlobFetcher>,
 }
 
 impl Internals {
-    fn init<P: AsRef<Path>>(path: P, needs_update: &mut bool) -> Fallible<Self> {
+    fn init<P: AsRef<Path>>(
+        path: P,
+        blob_cache_len: usize,
+        needs_update: &mut bool,
+    ) -> Fallible<Self> {
         let path = path.as_ref().join("database");
-        let (conn, was_reset) = create_schema(&path)?;
+        let was_reset = create_schema(&path)?;
 
         if was_reset {
             *needs_update = true;
         }
 
+        let query_worker = QueryWorker::new(&path)?;
+
+        let pool = ConnectionPool::new(&path);
+
         Ok(Self {
             path,
-            conn,
-            text_fetcher: BlobFetcher::new(),
-            url_fetcher: BlobFetcher::new(),
+            pool,
+            query_worker,
+            fetcher: Arc::new(BlobFetcher::new(blob_cache_len)),
         })
     }
 
-    fn start_update<U, C>(&mut self, url: String, updater: U, completion: C)
+    fn start_update<U, P, C>(
+        &self,
+        url: String,
+        updater: U,
+        progress: P,
+        completion: C,
+    ) -> UpdateHandle
     where
-        U: 'static + FnOnce(&Connection, &Receiver<Item>) -> Fallible + Send,
-        C: 'static + FnOnce(Fallible) + Send,
+        U: 'static
+            + FnOnce(&Connection, &Receiver<Item>, &AtomicU64, &AtomicBool) -> Fallible
+            + Send,
+        P: 'static + FnMut(&Progress) + Send,
+        C: 'static + FnOnce(Fallible, bool) + Send,
     {
         let path = self.path.clone();
+        let fetcher = self.fetcher.clone();
+
+        let cancelled = Arc::new(AtomicBool::new(false));
+
+        let thread = {
+            let cancelled = cancelled.clone();
+
+            spawn(move || {
+                let res = Self::update(&path, url, &cancelled, updater, progress);
+
+                // Full updates replace the dictionaries and the frames using them.
+                if res.is_ok() {
+                    fetcher.clear();
+                }
+
+                // An update which was cancelled but still completed successfully is reported as such.
+                let cancelled = res.is_err() && cancelled.load(Ordering::Relaxed);
+
+                completion(res, cancelled);
+            })
+        };
 
-        spawn(move || {
-            completion(Self::update(&path, url, updater));
-        });
+        UpdateHandle {
+            cancelled,
+            thread: Some(thread),
+        }
     }
 
-    fn update<U>(path: &Path, url: String, updater: U) -> Fallible
+    fn update<U, P>(
+        path: &Path,
+        url: String,
+        cancelled: &AtomicBool,
+        updater: U,
+        mut report: P,
+    ) -> Fallible
     where
-        U: FnOnce(&Connection, &Receiver<Item>) -> Fallible,
+        U: FnOnce(&Connection, &Receiver<Item>, &AtomicU64, &AtomicBool) -> Fallible,
+        P: FnMut(&Progress) + Send,
     {
-        let (sender, receiver) = sync_channel(128);
+        let progress = &Progress::default();
 
-        let parser = spawn(move || -> Fallible {
-            let resp = Request::get(url).empty()?.send()?;
+        scope(|scope| {
+            // Progress is reported until the update finishes and drops the sender, successfully or not.
+            let (_finished, ticks) = channel::<()>();
 
-            if !resp.status().is_success() {
-                return Err(format!("Failed to download update: {}", resp.status()).into());
-            }
+            scope.spawn(move || {
+                while let Err(RecvTimeoutError::Timeout) = ticks.recv_timeout(PROGRESS_INTERVAL) {
+                    report(progress);
+                }
 
-            parse(&mut XzDecoder::new(resp.into_body()), sender)
-        });
+                report(progress);
+            });
 
-        let mut conn = open_connection(path)?;
+            let (sender, receiver) = sync_channel(128);
 
-        let trans = conn.transaction()?;
+            let parser = scope.spawn(move || -> Fallible {
+                // Reads time out periodically so that a stalled download still notices cancellation.
+                let opts = Options {
+                    timeout: Some(READ_TIMEOUT),
+                    ..Options::default()
+                };
 
-        updater(&trans, &receiver)?;
+                let resp = Request::get(url).empty()?.send_with_opts(opts)?;
 
-        parser.join().unwrap()?;
+                if !resp.status().is_success() {
+                    return Err(format!("Failed to download update: {}", resp.status()).into());
+                }
 
-        trans.execute("ANALYZE", [])?;
+                if let Some(len) = resp.headers().get(CONTENT_LENGTH) {
+                    let len = len.to_str()?.parse()?;
+                    progress.download_len.store(len, Ordering::Relaxed);
+                }
 
-        trans.commit()?;
+                // Cancelling fails the download, which stops the parser and in turn the writer.
+                let body = Cancellable::new(resp.into_body(), cancelled);
+                let body = Counted::new(body, &progress.downloaded);
+                let mut reader = Counted::new(decoder(body)?, &progress.decompressed);
 
-        conn.execute_batch("PRAGMA wal_checkpoint(TRUNCATE);")?;
+                parse(&mut reader, sender, &progress.parsed)
+            });
 
-        Ok(())
+            let mut conn = open_connection(path)?;
+
+            let trans = conn.transaction()?;
+
+            updater(&trans, &receiver, &progress.inserted, cancelled)?;
+
+            parser.join().unwrap()?;
+
+            // Dropping the transaction without committing it rolls back all changes.
+            if cancelled.load(Ordering::Relaxed) {
+                return Err("Update cancelled".into());
+            }
+
+            trans.execute("ANALYZE", [])?;
+
+            trans.commit()?;
+
+            conn.execute_batch("PRAGMA wal_checkpoint(TRUNCATE);")?;
+
+            Ok(())
+        })
+    }
+
+    fn indexes(&self) -> Fallible<Indexes> {
+        let conn = self.pool.get()?;
+
+        populated_indexes(&conn)
     }
 
-    fn channels<C: FnMut(StringData)>(&mut self, mut consumer: C) -> Fallible {
-        let mut stmt = self
-            .conn
-            .prepare_cached("SELECT DISTINCT(channel) FROM channels")?;
+    fn channels<C: FnMut(StringData)>(&self, mut consumer: C) -> Fallible {
+        let conn = self.pool.get()?;
+
+        let mut stmt = conn.prepare_cached("SELECT DISTINCT(channel) FROM channels")?;
 
         let mut rows = stmt.query([])?;
 
@@ -126,17 +261,22 @@ impl Internals {
         Ok(())
     }
 
-    fn topics<C: FnMut(StringData)>(&mut self, channel: &str, mut consumer: C) -> Fallible {
-        let mut stmt = self.conn.prepare_cached(
+    fn topics<C: FnMut(StringData)>(&self, channel: &str, mut consumer: C) -> Fallible {
+        let conn = self.pool.get()?;
+
+        let mut stmt = conn.prepare_cached(
             r#"
 SELECT DISTINCT(topic)
 FROM channels, topics
 WHERE channels.id = topics.channel_id
-AND channels.channel LIKE ? || '%'
+AND channels.channel_key >= ?
+AND channels.channel_key < ?
 "#,
         )?;
 
-        let mut rows = stmt.query([&channel])?;
+        let channel = search_key(channel);
+
+        let mut rows = stmt.query(params![channel, prefix_end(&channel)])?;
 
         while let Some(row) = rows.next()? {
             consumer(row.get_ref_unwrap(0).as_str()?.into());
@@ -145,159 +285,257 @@ AND channels.channel LIKE ? || '%'
         Ok(())
     }
 
-    fn query<C: FnMut(i64)>(
-        &mut self,
-        channel: &str,
-        topic: &str,
-        title: &str,
-        sort_column: SortColumn,
-        sort_order: SortOrder,
-        mut consumer: C,
+    fn names<C: FnMut(i64, &str), T: FnMut(i64, &str)>(
+        &self,
+        mut channels: C,
+        mut topics: T,
     ) -> Fallible {
-        let mut params = Vec::<&dyn ToSql>::new();
+        let conn = self.pool.get()?;
 
-        let channel_filter = if !channel.is_empty() {
-            params.push(&channel);
-            "AND channels.channel LIKE ? || '%'"
-        } else {
-            ""
-        };
+        let mut stmt = conn.prepare("SELECT id, channel FROM channels")?;
+        let mut rows = stmt.query([])?;
 
-        let topic_filter = if !topic.is_empty() {
-            params.push(&topic);
-            "AND topics.topic LIKE ? || '%'"
-        } else {
-            ""
-        };
+        while let Some(row) = rows.next()? {
+            channels(row.get(0)?, row.get_ref_unwrap(1).as_str()?);
+        }
 
-        let title_filter = if !title.is_empty() {
-            params.push(&title);
-            r#"AND shows_by_title MATCH ? || '*'"#
-        } else {
-            ""
-        };
+        let mut stmt = conn.prepare("SELECT id, topic FROM topics")?;
+        let mut rows = stmt.query([])?;
 
-        let order_by = match (sort_column, sort_order) {
-            (SortColumn::Channel, SortOrder::Ascending) => {
-                "shows.topic_id ASC, shows.date DESC, shows.time DESC"
-            }
-            (SortColumn::Channel, SortOrder::Descending) => {
-                "shows.topic_id DESC, shows.date DESC, shows.time DESC"
-            }
-            (SortColumn::Topic, SortOrder::Ascending) => "topics.topic ASC",
-            (SortColumn::Topic, SortOrder::Descending) => "topics.topic DESC",
-            (SortColumn::Date, SortOrder::Ascending) => "shows.date ASC, shows.time ASC",
-            (SortColumn::Date, SortOrder::Descending) => "shows.date DESC, shows.time DESC",
-            (SortColumn::Time, SortOrder::Ascending) => "shows.time ASC",
-            (SortColumn::Time, SortOrder::Descending) => "shows.time DESC",
-            (SortColumn::Duration, SortOrder::Ascending) => "shows.duration ASC",
-            (SortColumn::Duration, SortOrder::Descending) => "shows.duration DESC",
-        };
+        while let Some(row) = rows.next()? {
+            topics(row.get(0)?, row.get_ref_unwrap(1).as_str()?);
+        }
 
-        let mut stmt = self.conn.prepare_cached(&format!(
-            r#"
-SELECT shows.id
-FROM channels, topics, shows, shows_by_title
-WHERE channels.id = topics.channel_id
-AND topics.id = shows.topic_id
-AND shows.id = shows_by_title.rowid
-{channel_filter}
-{topic_filter}
-{title_filter}
-ORDER BY {order_by}
-"#
-        ))?;
+        Ok(())
+    }
+
+    fn fetch_summaries<C: FnMut(i64, SummaryData)>(
+        &self,
+        ids: &[i64],
+        mut consumer: C,
+    ) -> Fallible {
+        let mut conn = self.pool.get()?;
+        let trans = conn.transaction()?;
 
-        let mut rows = stmt.query(params.as_slice())?;
+        let mut stmt = trans.prepare_cached(SELECT_SUMMARY)?;
+
+        let mut rows = Vec::with_capacity(ids.len());
+
+        for &id in ids {
+            // Shows might have been deleted by a partial update since they were queried.
+            let row = match stmt
+                .query_row([&id], |row| {
+                    Ok(SummaryRow {
+                        id,
+                        channel_id: row.get(0)?,
+                        topic_id: row.get(1)?,
+                        title_blob_id: row.get(2)?,
+                        title_offset: row.get(3)?,
+                        date: row.get(4)?,
+                        time: row.get(5)?,
+                        duration: row.get(6)?,
+                    })
+                })
+                .optional()?
+            {
+                Some(row) => row,
+                None => continue,
+            };
+
+            rows.push(row);
+        }
 
-        while let Some(row) = rows.next()? {
-            consumer(row.get(0)?);
+        let titles = self.fetcher.fetch(
+            &trans,
+            rows.iter().map(|row| (row.title_blob_id, row.title_offset)),
+        )?;
+
+        for row in &rows {
+            let title = titles
+                .get(row.title_blob_id, row.title_offset)?
+                .next()
+                .unwrap();
+
+            consumer(
+                row.id,
+                SummaryData {
+                    channel_id: row.channel_id,
+                    topic_id: row.topic_id,
+                    title: title.into(),
+                    date: row.date,
+                    time: row.time,
+                    duration: row.duration,
+                },
+            );
         }
 
         Ok(())
     }
 
-    fn fetch<C: FnOnce(ShowData)>(&mut self, id: i64, consumer: C) -> Fallible {
-        let trans = self.conn.transaction()?;
+    fn fetch_many<C: FnMut(i64, ShowData)>(&self, ids: &[i64], mut consumer: C) -> Fallible {
+        let mut conn = self.pool.get()?;
+        let trans = conn.transaction()?;
 
         let mut stmt = trans.prepare_cached(
             r#"
 SELECT
-    channels.channel,
-    topics.topic,
-    shows.text_blob_id,
-    shows.text_offset,
+    topics.channel_id,
+    shows.topic_id,
+    shows.title_blob_id,
+    shows.title_offset,
+    shows.description_blob_id,
+    shows.description_offset,
     shows.url_blob_id,
     shows.url_offset,
     shows.url_mask,
     shows.date,
     shows.time,
     shows.duration
-FROM channels, topics, shows, shows_by_title
-WHERE channels.id = topics.channel_id
-AND topics.id = shows.topic_id
+FROM topics, shows
+WHERE topics.id = shows.topic_id
 AND shows.id = ?
 "#,
         )?;
 
-        let mut rows = stmt.query([&id])?;
-        let row = rows
-            .next()?
-            .ok_or_else(|| format!("No show with ID {id}"))?;
-
-        let channel = row.get_ref_unwrap(0).as_str()?;
-        let topic = row.get_ref_unwrap(1).as_str()?;
-
-        let mut texts = self.text_fetcher.fetch(&trans, row.get(2)?, row.get(3)?)?;
-        let mut urls = self.url_fetcher.fetch(&trans, row.get(4)?, row.get(5)?)?;
-
-        let url_mask = row.get::<_, u32>(6)?;
-
-        let date = row.get(7)?;
-        let time = row.get(8)?;
-        let duration = row.get(9)?;
-
-        let title = texts.next().unwrap();
-        let description = texts.next().unwrap();
-
-        let url = urls.next().unwrap();
-
-        let url_small = if url_mask & URL_SMALL != 0 {
-            Some(urls.next().unwrap())
-        } else {
-            None
-        };
+        let mut rows = Vec::with_capacity(ids.len());
+
+        for &id in ids {
+            // Shows might have been deleted by a partial update since they were queried.
+            let row = match stmt
+                .query_row([&id], |row| {
+                    Ok(ShowRow {
+                        id,
+                        channel_id: row.get(0)?,
+                        topic_id: row.get(1)?,
+                        title_blob_id: row.get(2)?,
+                        title_offset: row.get(3)?,
+                        description_blob_id: row.get(4)?,
+                        description_offset: row.get(5)?,
+                        url_blob_id: row.get(6)?,
+                        url_offset: row.get(7)?,
+                        url_mask: row.get(8)?,
+                        date: row.get(9)?,
+                        time: row.get(10)?,
+                        duration: row.get(11)?,
+                    })
+                })
+                .optional()?
+            {
+                Some(row) => row,
+                None => continue,
+            };
+
+            rows.push(row);
+        }
 
-        let url_large = if url_mask & URL_LARGE != 0 {
-            Some(urls.next().unwrap())
-        } else {
-            None
-        };
+        let blobs = self.fetcher.fetch(
+            &trans,
+            rows.iter()
+                .map(|row| (row.title_blob_id, row.title_offset))
+                .chain(
+                    rows.iter()
+                        .map(|row| (row.description_blob_id, row.description_offset)),
+                )
+                .chain(rows.iter().map(|row| (row.url_blob_id, row.url_offset))),
+        )?;
 
-        let website = urls.next().unwrap();
-
-        consumer(ShowData {
-            channel: channel.into(),
-            topic: topic.into(),
-            title: title.into(),
-            description: description.into(),
-            website: website.into(),
-            date,
-            time,
-            duration,
-            url: url.into(),
-            url_small: url_small.into(),
-            url_large: url_large.into(),
-        });
+        for row in &rows {
+            let title = blobs
+                .get(row.title_blob_id, row.title_offset)?
+                .next()
+                .unwrap();
+
+            let description = blobs
+                .get(row.description_blob_id, row.description_offset)?
+                .next()
+                .unwrap();
+
+            let mut urls = blobs.get(row.url_blob_id, row.url_offset)?;
+
+            let url = urls.next().unwrap();
+
+            let url_small = if row.url_mask & URL_SMALL != 0 {
+                Some(urls.next().unwrap())
+            } else {
+                None
+            };
+
+            let url_large = if row.url_mask & URL_LARGE != 0 {
+                Some(urls.next().unwrap())
+            } else {
+                None
+            };
+
+            let website = urls.next().unwrap();
+
+            consumer(
+                row.id,
+                ShowData {
+                    channel_id: row.channel_id,
+                    topic_id: row.topic_id,
+                    title: title.into(),
+                    description: description.into(),
+                    website: website.into(),
+                    date: row.date,
+                    time: row.time,
+                    duration: row.duration,
+                    url: url.into(),
+                    url_small: url_small.into(),
+                    url_large: url_large.into(),
+                },
+            );
+        }
 
         Ok(())
     }
 }
 
+const SELECT_SUMMARY: &str = r#"
+SELECT
+    topics.channel_id,
+    shows.topic_id,
+    shows.title_blob_id,
+    shows.title_offset,
+    shows.date,
+    shows.time,
+    shows.duration
+FROM topics, shows
+WHERE topics.id = shows.topic_id
+AND shows.id = ?
+"#;
+
+struct SummaryRow {
+    id: i64,
+    channel_id: i64,
+    topic_id: i64,
+    title_blob_id: i64,
+    title_offset: u32,
+    date: i64,
+    time: u32,
+    duration: u32,
+}
+
+struct ShowRow {
+    id: i64,
+    channel_id: i64,
+    topic_id: i64,
+    title_blob_id: i64,
+    title_offset: u32,
+    description_blob_id: i64,
+    description_offset: u32,
+    url_blob_id: i64,
+    url_offset: u32,
+    url_mask: u32,
+    date: i64,
+    time: u32,
+    duration: u32,
+}
+
 extern "C" {
-    fn append_integer(ids: *mut c_void, data: i64);
     fn append_string(strings: *mut c_void, data: StringData);
-    fn fetch_show(show: *mut c_void, data: *const ShowData);
+    fn insert_name(names: *mut c_void, id: i64, data: StringData);
+    fn fetch_summary(summaries: *mut c_void, id: i64, data: *const SummaryData);
+    fn fetch_show(shows: *mut c_void, id: i64, data: *const ShowData);
 }
 
 #[repr(C)]
@@ -342,10 +580,20 @@ impl StringData {
     }
 }
 
+#[repr(C)]
+pub struct SummaryData {
+    channel_id: i64,
+    topic_id: i64,
+    title: StringData,
+    date: i64,
+    time: u32,
+    duration: u32,
+}
+
 #[repr(C)]
 pub struct ShowData {
-    channel: StringData,
-    topic: StringData,
+    channel_id: i64,
+    topic_id: i64,
     title: StringData,
     date: i64,
     time: u32,
@@ -360,11 +608,12 @@ pub struct ShowData {
 #[no_mangle]
 pub unsafe extern "C" fn internals_init(
     path: *const c_char,
+    blob_cache_len: usize,
     needs_update: *mut bool,
 ) -> *mut Internals {
     let path = OsStr::from_bytes(CStr::from_ptr(path).to_bytes());
 
-    match Internals::init(path, &mut *needs_update) {
+    match Internals::init(path, blob_cache_len, &mut *needs_update) {
         Ok(internals) => Box::into_raw(Box::new(internals)),
         Err(err) => {
             eprintln!("Failed to initialize internals: {err}");
@@ -379,16 +628,28 @@ pub unsafe extern "C" fn internals_drop(internals: *mut Internals) {
     let _ = Box::from_raw(internals);
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn internals_blob_cache_stats(
+    internals: *const Internals,
+    hits: *mut u64,
+    misses: *mut u64,
+) {
+    let (cache_hits, cache_misses) = (*internals).fetcher.stats();
+
+    *hits = cache_hits;
+    *misses = cache_misses;
+}
+
 #[repr(C)]
 pub struct Completion {
     context: *mut c_void,
-    action: unsafe extern "C" fn(context: *mut c_void, error: *const c_char),
+    action: unsafe extern "C" fn(context: *mut c_void, error: *const c_char, cancelled: bool),
 }
 
 unsafe impl Send for Completion {}
 
 impl Completion {
-    unsafe fn call(self, res: Fallible) {
+    unsafe fn call(self, res: Fallible, cancelled: bool) {
         let err = match res {
             Ok(()) => None,
             Err(err) => Some(CString::new(err.to_string()).unwrap()),
@@ -397,34 +658,96 @@ impl Completion {
         (self.action)(
             self.context,
             err.as_ref().map_or_else(null, |err| err.as_ptr()),
+            cancelled,
         );
     }
 }
 
+#[repr(C)]
+pub struct UpdateProgress {
+    context: *mut c_void,
+    action: unsafe extern "C" fn(context: *mut c_void, data: *const ProgressData),
+}
+
+unsafe impl Send for UpdateProgress {}
+
+impl UpdateProgress {
+    unsafe fn call(&mut self, progress: &Progress) {
+        let data = progress.data();
+
+        (self.action)(self.context, &data);
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn internals_full_update(
-    internals: *mut Internals,
+    internals: *const Internals,
     url: *const c_char,
+    indexes: Indexes,
+    mut progress: UpdateProgress,
     completion: Completion,
-) {
+) -> *mut UpdateHandle {
     let url = CStr::from_ptr(url).to_str().unwrap().to_owned();
 
-    (*internals).start_update(url, full_update, move |res| completion.call(res));
+    let handle = (*internals).start_update(
+        url,
+        move |conn, items, inserted, cancelled| {
+            full_update(conn, items, indexes, inserted, cancelled)
+        },
+        move |counters| progress.call(counters),
+        move |res, cancelled| completion.call(res, cancelled),
+    );
+
+    Box::into_raw(Box::new(handle))
 }
 
 #[no_mangle]
 pub unsafe extern "C" fn internals_partial_update(
-    internals: *mut Internals,
+    internals: *const Internals,
     url: *const c_char,
+    mut progress: UpdateProgress,
     completion: Completion,
-) {
+) -> *mut UpdateHandle {
     let url = CStr::from_ptr(url).to_str().unwrap().to_owned();
 
-    (*internals).start_update(url, partial_update, move |res| completion.call(res));
+    let handle = (*internals).start_update(
+        url,
+        partial_update,
+        move |counters| progress.call(counters),
+        move |res, cancelled| completion.call(res, cancelled),
+    );
+
+    Box::into_raw(Box::new(handle))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn internals_cancel_update(handle: *const UpdateHandle) {
+    (*handle).cancelled.store(true, Ordering::Relaxed);
+}
+
+// Blocks until the update has finished, so it should be cancelled first unless it already completed.
+#[no_mangle]
+pub unsafe extern "C" fn internals_drop_update(handle: *mut UpdateHandle) {
+    let _ = Box::from_raw(handle);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn internals_indexes(internals: *const Internals) -> Indexes {
+    match (*internals).indexes() {
+        Ok(indexes) => indexes,
+        Err(err) => {
+            eprintln!("Failed to check indexes: {err}");
+
+            Indexes {
+                descriptions: false,
+                title_trigrams: false,
+            }
+        }
+    }
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn internals_channels(internals: *mut Internals, channels: *mut c_void) {
+pub unsafe extern "C" fn internals_channels(internals: *const Internals, channels: *mut c_void) {
     if let Err(err) = (*internals).channels(|channel| append_string(channels, channel)) {
         eprintln!("Failed to fetch channels: {err}");
     }
@@ -432,7 +755,7 @@ pub unsafe extern "C" fn internals_channels(internals: *mut Internals, channels:
 
 #[no_mangle]
 pub unsafe extern "C" fn internals_topics(
-    internals: *mut Internals,
+    internals: *const Internals,
     channel: StringData,
     topics: *mut c_void,
 ) {
@@ -441,31 +764,293 @@ pub unsafe extern "C" fn internals_topics(
     }
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn internals_names(
+    internals: *const Internals,
+    channels: *mut c_void,
+    topics: *mut c_void,
+) {
+    if let Err(err) = (*internals).names(
+        |id, channel| insert_name(channels, id, channel.into()),
+        |id, topic| insert_name(topics, id, topic.into()),
+    ) {
+        eprintln!("Failed to fetch names: {err}");
+    }
+}
+
+#[repr(C)]
+pub struct QueryCompletion {
+    context: *mut c_void,
+    action: unsafe extern "C" fn(context: *mut c_void, generation: u64, count: usize, fuzzy: bool),
+}
+
+unsafe impl Send for QueryCompletion {}
+
+impl QueryCompletion {
+    unsafe fn call(self, generation: u64, count: usize, fuzzy: bool) {
+        (self.action)(self.context, generation, count, fuzzy);
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn internals_query(
-    internals: *mut Internals,
+    internals: *const Internals,
+    generation: u64,
     channel: StringData,
     topic: StringData,
     title: StringData,
+    description: StringData,
     sort_column: SortColumn,
     sort_order: SortOrder,
-    ids: *mut c_void,
+    completion: QueryCompletion,
 ) {
-    if let Err(err) = (*internals).query(
-        channel.as_str(),
-        topic.as_str(),
-        title.as_str(),
+    let query = Query {
+        generation,
+        channel: channel.as_str().to_owned(),
+        topic: topic.as_str().to_owned(),
+        title: title.as_str().to_owned(),
+        description: description.as_str().to_owned(),
         sort_column,
         sort_order,
-        |id| append_integer(ids, id),
-    ) {
-        eprintln!("Failed to query shows: {err}");
+    };
+
+    (*internals).query_worker.start(query, move |outcome| {
+        if let Outcome::Completed(ids, fuzzy) = outcome {
+            completion.call(generation, ids.len(), fuzzy);
+        }
+    });
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn internals_query_window(
+    internals: *const Internals,
+    generation: u64,
+    offset: usize,
+    len: usize,
+    ids: *mut usize,
+) -> usize {
+    match (*internals).query_worker.window(generation, offset, len) {
+        Some(window) => {
+            let ids = from_raw_parts_mut(ids, len);
+
+            for (id, &window_id) in ids.iter_mut().zip(&window) {
+                *id = window_id as usize;
+            }
+
+            window.len()
+        }
+        None => 0,
     }
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn internals_fetch(internals: *mut Internals, id: i64, show: *mut c_void) {
-    if let Err(err) = (*internals).fetch(id, |data| fetch_show(show, &data)) {
-        eprintln!("Failed to fetch show: {err}");
+pub unsafe extern "C" fn internals_query_release(internals: *const Internals, generation: u64) {
+    (*internals).query_worker.release(generation);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn internals_fetch_summaries(
+    internals: *const Internals,
+    ids: *const usize,
+    len: usize,
+    summaries: *mut c_void,
+) {
+    let ids = from_raw_parts(ids, len)
+        .iter()
+        .map(|&id| id as i64)
+        .collect::<Vec<_>>();
+
+    if let Err(err) =
+        (*internals).fetch_summaries(&ids, |id, data| fetch_summary(summaries, id, &data))
+    {
+        eprintln!("Failed to fetch show summaries: {err}");
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn internals_fetch_many(
+    internals: *const Internals,
+    ids: *const usize,
+    len: usize,
+    shows: *mut c_void,
+) {
+    let ids = from_raw_parts(ids, len)
+        .iter()
+        .map(|&id| id as i64)
+        .collect::<Vec<_>>();
+
+    if let Err(err) = (*internals).fetch_many(&ids, |id, data| fetch_show(shows, id, &data)) {
+        eprintln!("Failed to fetch shows: {err}");
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use self::database::SCHEMA;
+
+    #[test]
+    fn summary_plan() {
+        let conn = Connection::open_in_memory().unwrap();
+        conn.execute_batch(SCHEMA).unwrap();
+
+        let mut stmt = conn
+            .prepare(&format!("EXPLAIN QUERY PLAN {SELECT_SUMMARY}"))
+            .unwrap();
+        let mut rows = stmt.query([&0]).unwrap();
+
+        while let Some(row) = rows.next().unwrap() {
+            let detail = row.get::<_, String>(3).unwrap();
+
+            assert!(!detail.contains("shows_by_title"), "{}", detail);
+            assert!(detail.contains("USING INTEGER PRIMARY KEY"), "{}", detail);
+        }
+    }
+
+    // Run using `FILMLISTE=/path/to/Filmliste-akt.xz cargo test --release -- --ignored --nocapture trigram_index_cost`.
+    #[test]
+    #[ignore]
+    fn trigram_index_cost() {
+        use std::fs::{create_dir_all, remove_dir_all, File};
+        use std::io::BufReader;
+        use std::time::Instant;
+
+        let path = std::env::var_os("FILMLISTE").expect("FILMLISTE not set");
+
+        let dir = std::env::temp_dir().join(format!("internals-trigrams-{}", std::process::id()));
+        create_dir_all(&dir).unwrap();
+
+        for title_trigrams in [false, true] {
+            let db = dir.join(format!("database-{title_trigrams}"));
+            create_schema(&db).unwrap();
+
+            let mut conn = open_connection(&db).unwrap();
+
+            let start = Instant::now();
+
+            {
+                let trans = conn.transaction().unwrap();
+
+                let (sender, receiver) = sync_channel(128);
+
+                let path = path.clone();
+                let parser = spawn(move || {
+                    let mut reader = decoder(BufReader::new(File::open(path).unwrap())).unwrap();
+                    parse(&mut reader, sender, &AtomicU64::new(0))
+                });
+
+                let indexes = Indexes {
+                    descriptions: false,
+                    title_trigrams,
+                };
+
+                full_update(
+                    &trans,
+                    &receiver,
+                    indexes,
+                    &AtomicU64::new(0),
+                    &AtomicBool::new(false),
+                )
+                .unwrap();
+                parser.join().unwrap().unwrap();
+
+                trans.commit().unwrap();
+            }
+
+            let elapsed = start.elapsed().as_secs_f64();
+
+            // The size of a full-text index is that of its shadow tables.
+            let index_size = |table: &str| {
+                conn.query_row(
+                    r#"
+SELECT COALESCE(SUM(pgsize), 0)
+FROM dbstat
+WHERE name IN (?1 || '_data', ?1 || '_idx', ?1 || '_content', ?1 || '_docsize', ?1 || '_config')
+"#,
+                    [table],
+                    |row| row.get::<_, i64>(0),
+                )
+                .unwrap() as f64
+                    / 1e6
+            };
+
+            println!(
+                "Trigrams {title_trigrams}: Imported in {elapsed:.1} s, prefix index {:.1} MB, trigram index {:.1} MB",
+                index_size("shows_by_title"),
+                index_size("shows_by_title_trigram"),
+            );
+        }
+
+        remove_dir_all(dir).unwrap();
+    }
+
+    // Run using `cargo test --release -- --ignored --nocapture pool_throughput`.
+    #[test]
+    #[ignore]
+    fn pool_throughput() {
+        use std::fs::remove_dir_all;
+        use std::thread::scope;
+        use std::time::Instant;
+
+        const QUERIES: usize = 2_000;
+
+        let dir = std::env::temp_dir().join(format!("internals-pool-{}", std::process::id()));
+        let internals = Internals::init(&dir, 0, &mut false).unwrap();
+
+        {
+            let mut conn = open_connection(&internals.path).unwrap();
+            let trans = conn.transaction().unwrap();
+
+            for channel_id in 0..100 {
+                let channel = format!("Channel {channel_id}");
+
+                trans
+                    .execute(
+                        "INSERT INTO channels (id, channel, channel_key) VALUES (?, ?, ?)",
+                        params![channel_id, channel, search_key(&channel)],
+                    )
+                    .unwrap();
+
+                for topic_id in 0..100 {
+                    let topic = format!("Topic {topic_id}");
+
+                    trans
+                        .execute(
+                            "INSERT INTO topics (topic, topic_key, channel_id) VALUES (?, ?, ?)",
+                            params![topic, search_key(&topic), channel_id],
+                        )
+                        .unwrap();
+                }
+            }
+
+            trans.commit().unwrap();
+        }
+
+        for threads in [1, 2, 4, 8] {
+            let start = Instant::now();
+
+            scope(|scope| {
+                for _ in 0..threads {
+                    scope.spawn(|| {
+                        for query in 0..QUERIES / threads {
+                            let channel = format!("Channel {}", query % 100);
+
+                            internals.topics(&channel, |_| ()).unwrap();
+                        }
+                    });
+                }
+            });
+
+            let elapsed = start.elapsed().as_secs_f64();
+
+            println!(
+                "{threads} threads: {:.0} queries per second",
+                QUERIES as f64 / elapsed
+            );
+        }
+
+        drop(internals);
+        remove_dir_all(dir).unwrap();
     }
 }
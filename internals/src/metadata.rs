@@ -0,0 +1,169 @@
+use std::cmp::Reverse;
+use std::collections::HashSet;
+use std::convert::TryInto;
+
+use rayon::prelude::*;
+use rusqlite::Connection;
+
+use super::{
+    database::{SortRanks, SORT_RANKS},
+    Fallible, SortColumn, SortOrder,
+};
+
+#[derive(Default)]
+pub struct Metadata {
+    ids: Vec<i64>,
+    topic_ids: Vec<u32>,
+    channel_ids: Vec<u32>,
+    ranks: [Vec<u32>; SORT_RANKS],
+}
+
+impl Metadata {
+    pub fn load(conn: &Connection) -> Fallible<Self> {
+        let mut stmt = conn.prepare(
+            r#"
+SELECT
+    shows.id,
+    shows.topic_id,
+    topics.channel_id
+FROM topics, shows
+WHERE topics.id = shows.topic_id
+ORDER BY shows.id
+"#,
+        )?;
+
+        let mut rows = stmt.query([])?;
+        let mut metadata = Self::default();
+
+        while let Some(row) = rows.next()? {
+            metadata.ids.push(row.get(0)?);
+            metadata.topic_ids.push(row.get(1)?);
+            metadata.channel_ids.push(row.get(2)?);
+        }
+
+        let mut stmt = conn.prepare("SELECT id, ranks FROM sort_ranks")?;
+        let mut rows = stmt.query([])?;
+
+        while let Some(row) = rows.next()? {
+            let ranks = row
+                .get_ref_unwrap(1)
+                .as_blob()?
+                .chunks_exact(4)
+                .map(|rank| u32::from_le_bytes(rank.try_into().unwrap()))
+                .collect::<Vec<_>>();
+
+            if ranks.len() != metadata.ids.len() {
+                return Err("Sort ranks do not match shows".into());
+            }
+
+            let id: usize = row.get(0)?;
+
+            *metadata
+                .ranks
+                .get_mut(id)
+                .ok_or_else(|| format!("Unknown sort ranks {id}"))? = ranks;
+        }
+
+        Ok(metadata)
+    }
+
+    pub fn select(
+        &self,
+        channel_ids: Option<&HashSet<u32>>,
+        topic_ids: Option<&HashSet<u32>>,
+        ids: Option<&HashSet<i64>>,
+    ) -> Vec<usize> {
+        (0..self.ids.len())
+            .into_par_iter()
+            .filter(|&row| self.matches(row, channel_ids, topic_ids, ids))
+            .collect()
+    }
+
+    // Keeps the order of the given IDs, e.g. as ranked by the full-text index.
+    pub fn select_ranked(
+        &self,
+        ranked: &[i64],
+        channel_ids: Option<&HashSet<u32>>,
+        topic_ids: Option<&HashSet<u32>>,
+        ids: Option<&HashSet<i64>>,
+    ) -> Vec<i64> {
+        ranked
+            .par_iter()
+            .filter(|id| match self.ids.binary_search(id) {
+                Ok(row) => self.matches(row, channel_ids, topic_ids, ids),
+                Err(_) => false,
+            })
+            .copied()
+            .collect()
+    }
+
+    fn matches(
+        &self,
+        row: usize,
+        channel_ids: Option<&HashSet<u32>>,
+        topic_ids: Option<&HashSet<u32>>,
+        ids: Option<&HashSet<i64>>,
+    ) -> bool {
+        channel_ids.map_or(true, |channel_ids| {
+            channel_ids.contains(&self.channel_ids[row])
+        }) && topic_ids.map_or(true, |topic_ids| topic_ids.contains(&self.topic_ids[row]))
+            && ids.map_or(true, |ids| ids.contains(&self.ids[row]))
+    }
+
+    pub fn rows(&self, ids: &[i64]) -> Vec<usize> {
+        ids.par_iter()
+            .filter_map(|id| self.ids.binary_search(id).ok())
+            .collect()
+    }
+
+    pub fn sort(
+        &self,
+        mut rows: Vec<usize>,
+        sort_column: SortColumn,
+        sort_order: SortOrder,
+    ) -> Vec<i64> {
+        let sort_ranks = match sort_column {
+            SortColumn::Channel if sort_order == SortOrder::Descending => {
+                SortRanks::ChannelDescending
+            }
+            SortColumn::Channel => SortRanks::ChannelAscending,
+            SortColumn::Topic => SortRanks::Topic,
+            SortColumn::Title => SortRanks::Title,
+            SortColumn::Date => SortRanks::Date,
+            SortColumn::Time => SortRanks::Time,
+            SortColumn::Duration => SortRanks::Duration,
+            SortColumn::Relevance => return rows.iter().map(|&row| self.ids[row]).collect(),
+        };
+
+        let reverse = sort_column != SortColumn::Channel && sort_order == SortOrder::Descending;
+
+        let ranks = &self.ranks[sort_ranks as usize];
+
+        if ranks.len() != self.ids.len() {
+            return rows.iter().map(|&row| self.ids[row]).collect();
+        }
+
+        // Without any filter, the ranks can be inverted instead of sorting all shows.
+        if rows.len() == self.ids.len() {
+            let mut ids = vec![0; self.ids.len()];
+
+            for (row, &rank) in ranks.iter().enumerate() {
+                ids[rank as usize] = self.ids[row];
+            }
+
+            if reverse {
+                ids.reverse();
+            }
+
+            return ids;
+        }
+
+        if reverse {
+            rows.par_sort_unstable_by_key(|&row| Reverse(ranks[row]));
+        } else {
+            rows.par_sort_unstable_by_key(|&row| ranks[row]);
+        }
+
+        rows.par_iter().map(|&row| self.ids[row]).collect()
+    }
+}
@@ -1,12 +1,20 @@
+use std::collections::VecDeque;
 use std::io::Read;
-use std::sync::mpsc::SyncSender;
-
-use memchr::memmem::find;
-use serde::Deserialize;
-use serde_json::{from_slice, from_str, value::RawValue};
+use std::str::from_utf8;
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    mpsc::{channel, Receiver, SyncSender},
+};
+
+use memchr::{
+    memchr,
+    memmem::{find, rfind},
+};
+use rayon_core::{current_num_threads, spawn};
+use serde_json::from_slice;
 use time::{macros::format_description, Date, Time};
 
-use super::Fallible;
+use super::{scanner::find_quotes, Fallible};
 
 pub struct Item {
     pub channel: String,
@@ -22,7 +30,13 @@ pub struct Item {
     pub url_large: Option<String>,
 }
 
-pub fn parse<R: Read>(reader: &mut R, sender: SyncSender<Item>) -> Fallible {
+const CHUNK_LEN: usize = 1024 * 1024;
+
+type Chunk = Receiver<Fallible<Vec<Item>>>;
+
+pub fn parse<R: Read>(reader: &mut R, sender: SyncSender<Item>, parsed: &AtomicU64) -> Fallible {
+    const SUFFIX: &[u8] = b"],\"X\":[";
+
     let mut buf = Vec::new();
     let mut pos = 0;
 
@@ -35,25 +49,100 @@ pub fn parse<R: Read>(reader: &mut R, sender: SyncSender<Item>) -> Fallible {
         }
     }
 
+    // Items are parsed in parallel in chunks of whole records, but delivered in their original order
+    // as empty channels and topics are inherited from the preceding item.
+    let mut chunks = VecDeque::new();
+    let max_chunks = 2 * current_num_threads();
+
     loop {
-        if let Some((parsed, item)) = parse_item(&buf[pos..])? {
-            pos += parsed;
-            sender.send(item)?;
+        if !fill_buf(reader, &mut buf, &mut pos)? {
+            chunks.push_back(spawn_chunk(buf[pos..].to_vec(), true));
+            break;
+        }
+
+        if buf.len() - pos < CHUNK_LEN {
             continue;
-        } else if !fill_buf(reader, &mut buf, &mut pos)? {
-            let item = parse_last_item(&buf[pos..])?;
-            sender.send(item)?;
+        }
+
+        // Each chunk keeps the prefix of the following item so that its last item can be found.
+        if let Some(end) = rfind(&buf[pos..], SUFFIX) {
+            chunks.push_back(spawn_chunk(
+                buf[pos..][..end + SUFFIX.len()].to_vec(),
+                false,
+            ));
+            pos += end + 2;
+
+            deliver(&mut chunks, max_chunks, &sender, parsed)?;
+        }
+    }
+
+    deliver(&mut chunks, 0, &sender, parsed)
+}
+
+fn spawn_chunk(chunk: Vec<u8>, last: bool) -> Chunk {
+    let (sender, receiver) = channel();
+
+    spawn(move || {
+        let _ = sender.send(parse_chunk(&chunk, last));
+    });
+
+    receiver
+}
+
+// Forwards the items of all chunks parsed so far, but waits for the oldest ones while too many are pending.
+fn deliver(
+    chunks: &mut VecDeque<Chunk>,
+    max_chunks: usize,
+    sender: &SyncSender<Item>,
+    parsed: &AtomicU64,
+) -> Fallible {
+    while let Some(chunk) = chunks.front() {
+        let items = if chunks.len() > max_chunks {
+            chunk.recv()?
+        } else if let Ok(items) = chunk.try_recv() {
+            items
+        } else {
             break;
+        };
+
+        chunks.pop_front();
+
+        let items = items?;
+        parsed.fetch_add(items.len() as u64, Ordering::Relaxed);
+
+        for item in items {
+            sender.send(item)?;
         }
     }
 
     Ok(())
 }
 
+fn parse_chunk(chunk: &[u8], last: bool) -> Fallible<Vec<Item>> {
+    let mut items = Vec::new();
+    let mut pos = 0;
+
+    while let Some((parsed, item)) = parse_item(&chunk[pos..])? {
+        pos += parsed;
+        items.push(item);
+    }
+
+    if last {
+        items.push(parse_last_item(&chunk[pos..])?);
+    } else if &chunk[pos..] != b"\"X\":[" {
+        return Err("Malformed item".into());
+    }
+
+    Ok(items)
+}
+
 fn fill_buf<R: Read>(reader: &mut R, buf: &mut Vec<u8>, pos: &mut usize) -> Fallible<bool> {
     let len = buf.len() - *pos;
-    buf.copy_within(*pos.., 0);
-    *pos = 0;
+
+    if *pos != 0 {
+        buf.copy_within(*pos.., 0);
+        *pos = 0;
+    }
 
     buf.resize(len + 32 * 1024, 0);
     let read = reader.read(&mut buf[len..])?;
@@ -118,28 +207,57 @@ fn parse_last_item(input: &[u8]) -> Fallible<Item> {
     parse_fields(&input[PREFIX.len() - 1..=input.len() - SUFFIX.len()])
 }
 
+// Only the positions of the quotes delimiting the strings are determined,
+// so that the fields we do not use are never looked at again.
 fn parse_fields(fields: &[u8]) -> Fallible<Item> {
-    #[derive(Deserialize)]
-    struct Field<'a>(#[serde(borrow)] &'a RawValue);
+    const FIELDS: usize = 20;
 
-    #[derive(Deserialize)]
-    struct Fields<'a>(#[serde(borrow)] [Field<'a>; 20]);
+    struct Fields<'a> {
+        input: &'a [u8],
+        quotes: Vec<usize>,
+    }
 
     impl Fields<'_> {
-        fn get(&self, index: usize) -> &str {
-            self.0[index].0.get()
+        fn get(&self, index: usize) -> &[u8] {
+            &self.input[self.quotes[2 * index] + 1..self.quotes[2 * index + 1]]
         }
 
         fn to_string(&self, index: usize) -> Fallible<String> {
-            from_str(self.get(index)).map_err(Into::into)
+            let field = self.get(index);
+
+            if memchr(b'\\', field).is_none() {
+                return Ok(from_utf8(field)?.to_owned());
+            }
+
+            let field = &self.input[self.quotes[2 * index]..=self.quotes[2 * index + 1]];
+
+            from_slice(field).map_err(Into::into)
         }
 
         fn as_str(&self, index: usize) -> Fallible<&str> {
-            from_str(self.get(index)).map_err(Into::into)
+            from_utf8(self.get(index)).map_err(Into::into)
         }
     }
 
-    let fields: Fields = from_slice(fields)?;
+    let mut quotes = Vec::with_capacity(2 * FIELDS);
+    find_quotes(fields, &mut quotes);
+
+    if quotes.len() != 2 * FIELDS
+        || fields.first() != Some(&b'[')
+        || fields.last() != Some(&b']')
+        || quotes.first() != Some(&1)
+        || quotes.last() != Some(&(fields.len() - 2))
+        || quotes[1..quotes.len() - 1]
+            .chunks_exact(2)
+            .any(|pair| pair[1] != pair[0] + 2 || fields[pair[0] + 1] != b',')
+    {
+        return Err("Malformed fields".into());
+    }
+
+    let fields = Fields {
+        input: fields,
+        quotes,
+    };
 
     let channel = fields.to_string(0)?;
     let topic = fields.to_string(1)?;
@@ -214,4 +332,87 @@ mod tests {
             parse_url_suffix("foo://bar/baz", "10|qux".to_owned()).unwrap()
         );
     }
+
+    #[test]
+    fn escaped_fields() {
+        let item = parse_fields(
+            br#"["ARD","Tatort","Der \"Fall\"","01.01.2020","20:15:00","01:30:00","","Zeile 1\nZeile 2 \u00e4","http://ard.de/a.mp4","http://ard.de","","","14|b.mp4","","","","","","",""]"#,
+        )
+        .unwrap();
+
+        assert_eq!(item.title, "Der \"Fall\"");
+        assert_eq!(item.description, "Zeile 1\nZeile 2 ä");
+        assert_eq!(item.url_small.as_deref(), Some("http://ard.de/b.mp4"));
+
+        assert!(parse_fields(br#"["ARD","Tatort"]"#).is_err());
+        assert!(parse_fields(
+            br#"["ARD" "Tatort","","","","","","","","","","","","","","","","","",""]"#
+        )
+        .is_err());
+    }
+
+    // Run using `FILMLISTE=/path/to/Filmliste-akt.xz cargo test --release -- --ignored --nocapture parser_throughput`.
+    #[test]
+    #[ignore]
+    fn parser_throughput() {
+        use std::fs::File;
+        use std::io::BufReader;
+        use std::time::Instant;
+
+        use crate::decoder::decoder;
+
+        let path = std::env::var_os("FILMLISTE").expect("FILMLISTE not set");
+
+        let mut input = Vec::new();
+        decoder(BufReader::new(File::open(path).unwrap()))
+            .unwrap()
+            .read_to_end(&mut input)
+            .unwrap();
+
+        let (sender, receiver) = std::sync::mpsc::sync_channel(128);
+
+        let start = Instant::now();
+
+        let parser = std::thread::spawn(move || {
+            let len = input.len();
+            parse(&mut input.as_slice(), sender, &AtomicU64::new(0)).map(|()| len)
+        });
+
+        let items = receiver.iter().count();
+        let len = parser.join().unwrap().unwrap();
+
+        let elapsed = start.elapsed().as_secs_f64();
+
+        println!(
+            "Parsed {items} items at {:.0} MB/s",
+            len as f64 / elapsed / 1e6
+        );
+    }
+
+    #[test]
+    fn items_keep_their_order() {
+        let item = |title: usize| {
+            format!(
+                r#""X":["ARD","Tatort","Folge {title}","01.01.2020","20:15:00","01:30:00","","Beschreibung","http://ard.de/{title}.mp4","http://ard.de","","","","","","","","","",""]"#
+            )
+        };
+
+        let items = (0..20_000).map(item).collect::<Vec<_>>();
+        let input = format!(
+            r#"{{"Filmliste":["01.01.2020, 00:00","01.01.2020, 00:00","3","",""],{}}}"#,
+            items.join(",")
+        );
+        assert!(input.len() > 2 * CHUNK_LEN);
+
+        let (sender, receiver) = std::sync::mpsc::sync_channel(128);
+
+        let parser =
+            std::thread::spawn(move || parse(&mut input.as_bytes(), sender, &AtomicU64::new(0)));
+
+        for (title, item) in receiver.iter().enumerate() {
+            assert_eq!(item.title, format!("Folge {title}"));
+        }
+
+        parser.join().unwrap().unwrap();
+    }
 }
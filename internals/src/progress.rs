@@ -0,0 +1,201 @@
+use std::io::{BufRead, Error as IoError, ErrorKind, Read, Result as IoResult};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
+#[derive(Default)]
+pub struct Progress {
+    pub download_len: AtomicU64,
+    pub downloaded: AtomicU64,
+    pub decompressed: AtomicU64,
+    pub parsed: AtomicU64,
+    pub inserted: AtomicU64,
+}
+
+#[repr(C)]
+pub struct ProgressData {
+    download_len: u64,
+    downloaded: u64,
+    decompressed: u64,
+    parsed: u64,
+    inserted: u64,
+}
+
+impl Progress {
+    pub fn data(&self) -> ProgressData {
+        ProgressData {
+            download_len: self.download_len.load(Ordering::Relaxed),
+            downloaded: self.downloaded.load(Ordering::Relaxed),
+            decompressed: self.decompressed.load(Ordering::Relaxed),
+            parsed: self.parsed.load(Ordering::Relaxed),
+            inserted: self.inserted.load(Ordering::Relaxed),
+        }
+    }
+}
+
+// Counts the bytes consumed from the wrapped reader.
+pub struct Counted<'a, R> {
+    reader: R,
+    count: &'a AtomicU64,
+}
+
+impl<'a, R> Counted<'a, R> {
+    pub fn new(reader: R, count: &'a AtomicU64) -> Self {
+        Self { reader, count }
+    }
+}
+
+impl<R: Read> Read for Counted<'_, R> {
+    fn read(&mut self, buf: &mut [u8]) -> IoResult<usize> {
+        let read = self.reader.read(buf)?;
+        self.count.fetch_add(read as u64, Ordering::Relaxed);
+        Ok(read)
+    }
+}
+
+impl<R: BufRead> BufRead for Counted<'_, R> {
+    fn fill_buf(&mut self) -> IoResult<&[u8]> {
+        self.reader.fill_buf()
+    }
+
+    fn consume(&mut self, amt: usize) {
+        self.count.fetch_add(amt as u64, Ordering::Relaxed);
+        self.reader.consume(amt);
+    }
+}
+
+// Fails all reads from the wrapped reader once the update was cancelled.
+// Reads which time out are retried until then, so the wrapped reader should time out periodically.
+pub struct Cancellable<'a, R> {
+    reader: R,
+    cancelled: &'a AtomicBool,
+}
+
+impl<'a, R> Cancellable<'a, R> {
+    pub fn new(reader: R, cancelled: &'a AtomicBool) -> Self {
+        Self { reader, cancelled }
+    }
+
+    fn check(&self) -> IoResult<()> {
+        if self.cancelled.load(Ordering::Relaxed) {
+            return Err(IoError::new(ErrorKind::Other, "Update cancelled"));
+        }
+
+        Ok(())
+    }
+}
+
+fn is_timeout(err: &IoError) -> bool {
+    matches!(err.kind(), ErrorKind::TimedOut | ErrorKind::WouldBlock)
+}
+
+impl<R: Read> Read for Cancellable<'_, R> {
+    fn read(&mut self, buf: &mut [u8]) -> IoResult<usize> {
+        loop {
+            self.check()?;
+
+            match self.reader.read(buf) {
+                Err(err) if is_timeout(&err) => continue,
+                res => return res,
+            }
+        }
+    }
+}
+
+impl<R: BufRead> BufRead for Cancellable<'_, R> {
+    fn fill_buf(&mut self) -> IoResult<&[u8]> {
+        loop {
+            self.check()?;
+
+            match self.reader.fill_buf() {
+                Err(err) if is_timeout(&err) => continue,
+                Err(err) => return Err(err),
+                Ok(_) => break,
+            }
+        }
+
+        // Filling an already filled buffer does not read again.
+        self.reader.fill_buf()
+    }
+
+    fn consume(&mut self, amt: usize) {
+        self.reader.consume(amt);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn counts_consumed_bytes() {
+        let count = AtomicU64::new(0);
+        let mut reader = Counted::new(&b"foobar"[..], &count);
+
+        assert_eq!(reader.fill_buf().unwrap(), b"foobar");
+        assert_eq!(count.load(Ordering::Relaxed), 0);
+
+        reader.consume(2);
+
+        let mut buf = [0; 3];
+        reader.read_exact(&mut buf).unwrap();
+
+        assert_eq!(&buf, b"oba");
+        assert_eq!(count.load(Ordering::Relaxed), 5);
+    }
+
+    #[test]
+    fn fails_reads_once_cancelled() {
+        let cancelled = AtomicBool::new(false);
+        let mut reader = Cancellable::new(&b"foobar"[..], &cancelled);
+
+        let mut buf = [0; 3];
+        reader.read_exact(&mut buf).unwrap();
+
+        cancelled.store(true, Ordering::Relaxed);
+
+        assert!(reader.read_exact(&mut buf).is_err());
+        assert!(reader.fill_buf().is_err());
+    }
+
+    // Times out every other read, like a stalled connection.
+    struct Stalling<'a> {
+        data: &'a [u8],
+        stalled: bool,
+        cancelled: &'a AtomicBool,
+    }
+
+    impl Read for Stalling<'_> {
+        fn read(&mut self, buf: &mut [u8]) -> IoResult<usize> {
+            self.stalled = !self.stalled;
+
+            if self.stalled {
+                if self.data.is_empty() {
+                    self.cancelled.store(true, Ordering::Relaxed);
+                }
+
+                return Err(IoError::new(ErrorKind::TimedOut, "Stalled"));
+            }
+
+            self.data.read(buf)
+        }
+    }
+
+    #[test]
+    fn retries_timed_out_reads_until_cancelled() {
+        let cancelled = AtomicBool::new(false);
+        let stalling = Stalling {
+            data: b"foobar",
+            stalled: false,
+            cancelled: &cancelled,
+        };
+        let mut reader = Cancellable::new(stalling, &cancelled);
+
+        let mut buf = [0; 6];
+        reader.read_exact(&mut buf).unwrap();
+
+        assert_eq!(&buf, b"foobar");
+
+        let err = reader.read(&mut buf).unwrap_err();
+
+        assert_eq!(err.to_string(), "Update cancelled");
+    }
+}
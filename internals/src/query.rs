@@ -0,0 +1,660 @@
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::hash::Hash;
+use std::path::Path;
+use std::sync::{
+    atomic::{AtomicU64, Ordering},
+    mpsc::{channel, Receiver, Sender},
+    Arc, Mutex,
+};
+use std::thread::{spawn, JoinHandle};
+
+use rusqlite::{
+    ffi::ErrorCode, params, types::FromSql, Connection, Error as SqlError, InterruptHandle, Params,
+};
+
+use super::{
+    collation::{fold, prefix_end, search_key},
+    database::{is_populated, open_connection},
+    fuzzy::Vocabulary,
+    metadata::Metadata,
+    Fallible, SortColumn, SortOrder,
+};
+
+pub struct Query {
+    pub generation: u64,
+    pub channel: String,
+    pub topic: String,
+    pub title: String,
+    pub description: String,
+    pub sort_column: SortColumn,
+    pub sort_order: SortOrder,
+}
+
+pub enum Outcome {
+    Completed(Arc<Vec<i64>>, bool),
+    Cancelled,
+}
+
+type Task = (Query, Box<dyn FnOnce(Outcome) + Send>);
+
+pub struct QueryWorker {
+    sender: Option<Sender<Task>>,
+    generation: Arc<AtomicU64>,
+    results: Arc<Mutex<Results>>,
+    interrupt: InterruptHandle,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl QueryWorker {
+    pub fn new(path: &Path) -> Fallible<Self> {
+        let conn = open_connection(path)?;
+        let interrupt = conn.get_interrupt_handle();
+
+        let (sender, receiver) = channel();
+        let generation = Arc::new(AtomicU64::new(0));
+        let results = Arc::new(Mutex::new(Results::default()));
+
+        let thread = {
+            let generation = generation.clone();
+            let results = results.clone();
+
+            spawn(move || run(conn, receiver, generation, results))
+        };
+
+        Ok(Self {
+            sender: Some(sender),
+            generation,
+            results,
+            interrupt,
+            thread: Some(thread),
+        })
+    }
+
+    pub fn start<C>(&self, query: Query, completion: C)
+    where
+        C: 'static + FnOnce(Outcome) + Send,
+    {
+        self.generation.store(query.generation, Ordering::SeqCst);
+        self.interrupt.interrupt();
+
+        if let Some(sender) = &self.sender {
+            let _ = sender.send((query, Box::new(completion)));
+        }
+    }
+
+    pub fn window(&self, generation: u64, offset: usize, len: usize) -> Option<Vec<i64>> {
+        self.results.lock().unwrap().window(generation, offset, len)
+    }
+
+    // Drops all results older than the given generation.
+    pub fn release(&self, generation: u64) {
+        self.results.lock().unwrap().release(generation);
+    }
+}
+
+impl Drop for QueryWorker {
+    fn drop(&mut self) {
+        self.generation.store(u64::MAX, Ordering::SeqCst);
+        self.interrupt.interrupt();
+
+        drop(self.sender.take());
+
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+fn run(
+    conn: Connection,
+    receiver: Receiver<Task>,
+    generation: Arc<AtomicU64>,
+    results: Arc<Mutex<Results>>,
+) {
+    let is_current = |query: &Query| query.generation == generation.load(Ordering::SeqCst);
+
+    let mut cache = QueryCache::new();
+
+    while let Ok(mut task) = receiver.recv() {
+        // Only the most recent query is of interest, so skip all others queued up behind it.
+        while let Ok(next_task) = receiver.try_recv() {
+            let (_, completion) = task;
+            completion(Outcome::Cancelled);
+
+            task = next_task;
+        }
+
+        let (query, completion) = task;
+
+        if !is_current(&query) {
+            completion(Outcome::Cancelled);
+            continue;
+        }
+
+        match execute(&conn, &mut cache, &query, &|| !is_current(&query)) {
+            Ok((ids, fuzzy)) if is_current(&query) => {
+                results
+                    .lock()
+                    .unwrap()
+                    .insert(query.generation, ids.clone());
+
+                completion(Outcome::Completed(ids, fuzzy));
+            }
+            Err(err) if !is_interrupted(&*err) && is_current(&query) => {
+                eprintln!("Failed to query shows: {err}");
+
+                results
+                    .lock()
+                    .unwrap()
+                    .insert(query.generation, Default::default());
+
+                completion(Outcome::Completed(Default::default(), false));
+            }
+            _ => completion(Outcome::Cancelled),
+        }
+    }
+}
+
+// Completed results are kept so that the model can fetch them window by window.
+// They are retained until the model has adopted a later generation and released the older ones.
+#[derive(Default)]
+struct Results(VecDeque<(u64, Arc<Vec<i64>>)>);
+
+impl Results {
+    fn insert(&mut self, generation: u64, ids: Arc<Vec<i64>>) {
+        self.0.push_front((generation, ids));
+    }
+
+    fn release(&mut self, generation: u64) {
+        self.0
+            .retain(|(result_generation, _)| *result_generation >= generation);
+    }
+
+    fn window(&self, generation: u64, offset: usize, len: usize) -> Option<Vec<i64>> {
+        let (_, ids) = self
+            .0
+            .iter()
+            .find(|(result_generation, _)| *result_generation == generation)?;
+
+        let start = offset.min(ids.len());
+        let end = offset.saturating_add(len).min(ids.len());
+
+        Some(ids[start..end].to_vec())
+    }
+}
+
+fn is_interrupted(err: &(dyn std::error::Error + 'static)) -> bool {
+    matches!(
+        err.downcast_ref::<SqlError>(),
+        Some(SqlError::SqliteFailure(err, _)) if err.code == ErrorCode::OperationInterrupted
+    )
+}
+
+fn execute(
+    conn: &Connection,
+    cache: &mut QueryCache,
+    query: &Query,
+    is_cancelled: &dyn Fn() -> bool,
+) -> Fallible<(Arc<Vec<i64>>, bool)> {
+    cache.validate(conn)?;
+
+    if let Some(res) = cache.get(query) {
+        return Ok(res);
+    }
+
+    let trigrams = cache.title_trigrams(&query.title);
+
+    let ids = if let Some(ids) = cache.resort(query) {
+        ids
+    } else if let Some(ids) = cache.refine(query, |title| select_titles(conn, title, trigrams))? {
+        ids
+    } else {
+        let titles = if !query.title.is_empty() {
+            Some(select_titles(conn, &query.title, trigrams)?)
+        } else {
+            None
+        };
+
+        select(conn, &cache.metadata, query, titles)?
+    };
+
+    // If no title matches exactly, fall back to similar titles instead of showing nothing.
+    let fuzzy = ids.is_empty() && !query.title.is_empty();
+
+    let ids = if fuzzy {
+        select_similar(conn, cache, query, is_cancelled)?
+    } else {
+        ids
+    };
+
+    let ids = Arc::new(ids);
+    cache.insert(query, ids.clone(), fuzzy);
+
+    Ok((ids, fuzzy))
+}
+
+fn select(
+    conn: &Connection,
+    metadata: &Metadata,
+    query: &Query,
+    mut ids: Option<HashSet<i64>>,
+) -> Fallible<Vec<i64>> {
+    let channel_ids = if !query.channel.is_empty() {
+        let channel = search_key(&query.channel);
+
+        Some(select_ids(
+            conn,
+            "SELECT id FROM channels WHERE channel_key >= ? AND channel_key < ?",
+            params![channel, prefix_end(&channel)],
+        )?)
+    } else {
+        None
+    };
+
+    let topic_ids = if !query.topic.is_empty() {
+        let topic = search_key(&query.topic);
+
+        Some(select_ids(
+            conn,
+            "SELECT id FROM topics WHERE topic_key >= ? AND topic_key < ?",
+            params![topic, prefix_end(&topic)],
+        )?)
+    } else {
+        None
+    };
+
+    if !query.description.is_empty() {
+        if query.sort_column == SortColumn::Relevance {
+            let mut ranked = select_descriptions(conn, &query.description)?;
+
+            if query.sort_order == SortOrder::Descending {
+                ranked.reverse();
+            }
+
+            return Ok(metadata.select_ranked(
+                &ranked,
+                channel_ids.as_ref(),
+                topic_ids.as_ref(),
+                ids.as_ref(),
+            ));
+        }
+
+        let descriptions = match match_tokens(&query.description) {
+            Some(tokens) => select_ids(
+                conn,
+                "SELECT rowid FROM shows_by_description WHERE shows_by_description MATCH ?",
+                [&tokens],
+            )?,
+            None => select_ids(conn, "SELECT rowid FROM shows_by_description", [])?,
+        };
+
+        ids = Some(match ids {
+            Some(ids) => ids.intersection(&descriptions).copied().collect(),
+            None => descriptions,
+        });
+    }
+
+    let rows = metadata.select(channel_ids.as_ref(), topic_ids.as_ref(), ids.as_ref());
+
+    Ok(metadata.sort(rows, query.sort_column, query.sort_order))
+}
+
+// Ordered by their BM25 score, best matches first.
+fn select_descriptions(conn: &Connection, description: &str) -> Fallible<Vec<i64>> {
+    let tokens = match match_tokens(description) {
+        Some(tokens) => tokens,
+        None => return Ok(Vec::new()),
+    };
+
+    let mut stmt = conn.prepare_cached(
+        r#"
+SELECT rowid
+FROM shows_by_description
+WHERE shows_by_description MATCH ?
+ORDER BY rank
+"#,
+    )?;
+
+    let ids = stmt
+        .query_map([&tokens], |row| row.get(0))?
+        .collect::<Result<_, _>>()?;
+
+    Ok(ids)
+}
+
+// Shows are ordered by the sum of the edit distances between the words of their titles and the query.
+fn select_similar(
+    conn: &Connection,
+    cache: &mut QueryCache,
+    query: &Query,
+    is_cancelled: &dyn Fn() -> bool,
+) -> Fallible<Vec<i64>> {
+    let title = fold(&query.title);
+    let tokens = title
+        .split(|c: char| !c.is_alphanumeric())
+        .filter(|token| !token.is_empty())
+        .collect::<Vec<_>>();
+
+    let vocabulary = cache.vocabulary(conn)?;
+
+    let mut stmt = conn.prepare_cached(
+        "SELECT rowid FROM shows_by_title WHERE shows_by_title MATCH '\"' || ? || '\"'",
+    )?;
+
+    let mut distances = HashMap::<i64, u32>::new();
+
+    for (pos, token) in tokens.iter().enumerate() {
+        let prefix = pos + 1 == tokens.len();
+
+        let mut token_distances = HashMap::<i64, u32>::new();
+
+        // Scanning the vocabulary is not covered by interrupting the connection, so it checks the generation itself.
+        let terms = vocabulary
+            .similar(token, prefix, is_cancelled)
+            .ok_or("Query cancelled")?;
+
+        for (term, distance) in terms {
+            let mut rows = stmt.query([term])?;
+
+            while let Some(row) = rows.next()? {
+                let token_distance = token_distances.entry(row.get(0)?).or_insert(distance);
+                *token_distance = (*token_distance).min(distance);
+            }
+        }
+
+        if pos == 0 {
+            distances = token_distances;
+        } else {
+            distances = distances
+                .into_iter()
+                .filter_map(|(id, distance)| {
+                    token_distances
+                        .get(&id)
+                        .map(|token_distance| (id, distance + token_distance))
+                })
+                .collect();
+        }
+
+        if distances.is_empty() {
+            return Ok(Vec::new());
+        }
+    }
+
+    let titles = distances.keys().copied().collect();
+    let mut ids = select(conn, &cache.metadata, query, Some(titles))?;
+
+    ids.sort_by_key(|id| distances[id]);
+
+    Ok(ids)
+}
+
+// The trigram index matches the title as a substring instead of as a token prefix.
+fn select_titles(conn: &Connection, title: &str, trigrams: bool) -> Fallible<HashSet<i64>> {
+    let title = fold(title);
+
+    if trigrams {
+        return select_ids(
+            conn,
+            r#"
+SELECT rowid
+FROM shows_by_title_trigram
+WHERE shows_by_title_trigram MATCH '"' || replace(?, '"', '""') || '"'
+"#,
+            [&title],
+        );
+    }
+
+    match match_tokens(&title) {
+        Some(tokens) => select_ids(
+            conn,
+            "SELECT rowid FROM shows_by_title WHERE shows_by_title MATCH ?",
+            [&tokens],
+        ),
+        None => select_ids(conn, "SELECT rowid FROM shows_by_title", []),
+    }
+}
+
+// Each token is quoted so that user input is never interpreted as query syntax, the last one matching as a prefix.
+// Tokens without any letters or digits would yield empty phrases and are skipped.
+fn match_tokens(text: &str) -> Option<String> {
+    let mut tokens = String::new();
+
+    for token in text
+        .split_whitespace()
+        .filter(|token| token.chars().any(char::is_alphanumeric))
+    {
+        if !tokens.is_empty() {
+            tokens.push(' ');
+        }
+
+        tokens.push('"');
+        tokens.push_str(&token.replace('"', "\"\""));
+        tokens.push('"');
+    }
+
+    if tokens.is_empty() {
+        return None;
+    }
+
+    tokens.push('*');
+
+    Some(tokens)
+}
+
+fn select_ids<T, P>(conn: &Connection, sql: &str, params: P) -> Fallible<HashSet<T>>
+where
+    T: FromSql + Hash + Eq,
+    P: Params,
+{
+    let mut stmt = conn.prepare_cached(sql)?;
+
+    let mut rows = stmt.query(params)?;
+    let mut ids = HashSet::new();
+
+    while let Some(row) = rows.next()? {
+        ids.insert(row.get(0)?);
+    }
+
+    Ok(ids)
+}
+
+const CACHE_CAPACITY: usize = 8;
+
+struct CacheEntry {
+    channel: String,
+    topic: String,
+    title: String,
+    description: String,
+    sort_column: SortColumn,
+    sort_order: SortOrder,
+    ids: Arc<Vec<i64>>,
+    fuzzy: bool,
+}
+
+impl CacheEntry {
+    fn has_filter(&self, query: &Query) -> bool {
+        self.channel == query.channel
+            && self.topic == query.topic
+            && self.title == query.title
+            && self.description == query.description
+    }
+
+    fn has_sort(&self, query: &Query) -> bool {
+        self.sort_column == query.sort_column && self.sort_order == query.sort_order
+    }
+}
+
+struct QueryCache {
+    data_version: Option<i64>,
+    metadata: Metadata,
+    title_trigrams: bool,
+    vocabulary: Option<Vocabulary>,
+    entries: VecDeque<CacheEntry>,
+}
+
+impl QueryCache {
+    fn new() -> Self {
+        Self {
+            data_version: None,
+            metadata: Metadata::default(),
+            title_trigrams: false,
+            vocabulary: None,
+            entries: VecDeque::with_capacity(CACHE_CAPACITY),
+        }
+    }
+
+    // The data version changes whenever another connection, i.e. a database update, commits.
+    fn validate(&mut self, conn: &Connection) -> Fallible {
+        let data_version = conn.pragma_query_value(None, "data_version", |row| row.get(0))?;
+
+        if self.data_version != Some(data_version) {
+            self.entries.clear();
+            self.metadata = Metadata::load(conn)?;
+            self.title_trigrams = is_populated(conn, "shows_by_title_trigram")?;
+            self.vocabulary = None;
+            self.data_version = Some(data_version);
+        }
+
+        Ok(())
+    }
+
+    // Trigrams can only match titles of at least three characters.
+    fn title_trigrams(&self, title: &str) -> bool {
+        self.title_trigrams && fold(title).chars().count() >= 3
+    }
+
+    // The vocabulary is only loaded once a fuzzy search is actually needed.
+    fn vocabulary(&mut self, conn: &Connection) -> Fallible<&Vocabulary> {
+        if self.vocabulary.is_none() {
+            self.vocabulary = Some(Vocabulary::load(conn)?);
+        }
+
+        Ok(self.vocabulary.as_ref().unwrap())
+    }
+
+    fn get(&mut self, query: &Query) -> Option<(Arc<Vec<i64>>, bool)> {
+        let pos = self
+            .entries
+            .iter()
+            .position(|entry| entry.has_filter(query) && entry.has_sort(query))?;
+
+        let entry = self.entries.remove(pos).unwrap();
+        let res = (entry.ids.clone(), entry.fuzzy);
+        self.entries.push_front(entry);
+
+        Some(res)
+    }
+
+    // Results only differing in their sort order are re-sorted in memory instead of being queried again.
+    fn resort(&self, query: &Query) -> Option<Vec<i64>> {
+        // Similar titles are ordered by their distance first, which re-sorting would discard.
+        let entry = self
+            .entries
+            .iter()
+            .find(|entry| entry.has_filter(query) && !entry.fuzzy)?;
+
+        if entry.sort_column == query.sort_column && query.sort_column != SortColumn::Channel {
+            return Some(entry.ids.iter().rev().copied().collect());
+        }
+
+        // Relevance depends on the full-text index and cannot be derived from sort ranks.
+        if query.sort_column == SortColumn::Relevance {
+            return None;
+        }
+
+        let rows = self.metadata.rows(&entry.ids);
+
+        Some(
+            self.metadata
+                .sort(rows, query.sort_column, query.sort_order),
+        )
+    }
+
+    // As all tokens are quoted, every show matching the requested title also matches any prefix of it:
+    // Earlier tokens only become complete and later tokens only add further conditions.
+    fn refine<S>(&self, query: &Query, select_titles: S) -> Fallible<Option<Vec<i64>>>
+    where
+        S: FnOnce(&str) -> Fallible<HashSet<i64>>,
+    {
+        let entry = self
+            .entries
+            .iter()
+            .filter(|entry| {
+                !entry.fuzzy
+                    && entry.channel == query.channel
+                    && entry.topic == query.topic
+                    && entry.description == query.description
+                    && entry.has_sort(query)
+                    && query.title.len() > entry.title.len()
+                    && query.title.starts_with(&entry.title)
+                    && self.title_trigrams(&entry.title) == self.title_trigrams(&query.title)
+            })
+            .max_by_key(|entry| entry.title.len());
+
+        let entry = match entry {
+            Some(entry) => entry,
+            None => return Ok(None),
+        };
+
+        let titles = select_titles(&query.title)?;
+
+        Ok(Some(
+            entry
+                .ids
+                .iter()
+                .filter(|id| titles.contains(id))
+                .copied()
+                .collect(),
+        ))
+    }
+
+    fn insert(&mut self, query: &Query, ids: Arc<Vec<i64>>, fuzzy: bool) {
+        if self.entries.len() == CACHE_CAPACITY {
+            self.entries.pop_back();
+        }
+
+        self.entries.push_front(CacheEntry {
+            channel: query.channel.clone(),
+            topic: query.topic.clone(),
+            title: query.title.clone(),
+            description: query.description.clone(),
+            sort_column: query.sort_column,
+            sort_order: query.sort_order,
+            ids,
+            fuzzy,
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn quoted_match_tokens() {
+        assert_eq!(match_tokens("tatort"), Some(r#""tatort"*"#.to_owned()));
+        assert_eq!(match_tokens("a OR b"), Some(r#""a" "OR" "b"*"#.to_owned()));
+        assert_eq!(
+            match_tokens(r#"der "fall (1)"#),
+            Some(r#""der" """fall" "(1)"*"#.to_owned())
+        );
+        assert_eq!(match_tokens(" - \" "), None);
+    }
+
+    #[test]
+    fn keeps_results_until_released() {
+        let mut results = Results::default();
+
+        results.insert(1, Arc::new(vec![1, 2, 3]));
+        results.insert(2, Arc::new(vec![4]));
+        results.insert(3, Arc::new(vec![5, 6]));
+
+        assert_eq!(results.window(1, 1, 5), Some(vec![2, 3]));
+
+        results.release(2);
+
+        assert_eq!(results.window(1, 0, 5), None);
+        assert_eq!(results.window(2, 0, 5), Some(vec![4]));
+        assert_eq!(results.window(3, 0, 5), Some(vec![5, 6]));
+    }
+}
@@ -0,0 +1,118 @@
+const BLOCK_LEN: usize = 64;
+
+// Finds all quotes not escaped by a backslash, i.e. the delimiters of all strings.
+// Blocks without backslashes are classified using SIMD, all others byte by byte.
+pub fn find_quotes(input: &[u8], quotes: &mut Vec<usize>) {
+    let mut escaped = false;
+    let mut pos = 0;
+
+    while pos + BLOCK_LEN <= input.len() {
+        let block = &input[pos..pos + BLOCK_LEN];
+
+        let (quote_mask, backslash_mask) = masks(block);
+
+        if backslash_mask == 0 && !escaped {
+            push_positions(quote_mask, pos, quotes);
+        } else {
+            escaped = scan(block, pos, escaped, quotes);
+        }
+
+        pos += BLOCK_LEN;
+    }
+
+    scan(&input[pos..], pos, escaped, quotes);
+}
+
+fn push_positions(mut mask: u64, offset: usize, quotes: &mut Vec<usize>) {
+    while mask != 0 {
+        quotes.push(offset + mask.trailing_zeros() as usize);
+        mask &= mask - 1;
+    }
+}
+
+fn scan(input: &[u8], offset: usize, mut escaped: bool, quotes: &mut Vec<usize>) -> bool {
+    for (pos, &byte) in input.iter().enumerate() {
+        if escaped {
+            escaped = false;
+        } else if byte == b'\\' {
+            escaped = true;
+        } else if byte == b'"' {
+            quotes.push(offset + pos);
+        }
+    }
+
+    escaped
+}
+
+#[cfg(target_arch = "x86_64")]
+fn masks(block: &[u8]) -> (u64, u64) {
+    use std::arch::x86_64::{
+        __m128i, _mm_cmpeq_epi8, _mm_loadu_si128, _mm_movemask_epi8, _mm_set1_epi8,
+    };
+
+    assert_eq!(block.len(), BLOCK_LEN);
+
+    let mut quote_mask = 0;
+    let mut backslash_mask = 0;
+
+    // SSE2 is part of the x86-64 baseline, so no runtime detection is necessary.
+    unsafe {
+        let quote = _mm_set1_epi8(b'"' as i8);
+        let backslash = _mm_set1_epi8(b'\\' as i8);
+
+        for lane in 0..BLOCK_LEN / 16 {
+            let bytes = _mm_loadu_si128(block.as_ptr().add(16 * lane) as *const __m128i);
+
+            let quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)) as u16;
+            let backslashes = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, backslash)) as u16;
+
+            quote_mask |= (quotes as u64) << (16 * lane);
+            backslash_mask |= (backslashes as u64) << (16 * lane);
+        }
+    }
+
+    (quote_mask, backslash_mask)
+}
+
+#[cfg(not(target_arch = "x86_64"))]
+fn masks(block: &[u8]) -> (u64, u64) {
+    let mut quote_mask = 0;
+    let mut backslash_mask = 0;
+
+    for (pos, &byte) in block.iter().enumerate() {
+        quote_mask |= ((byte == b'"') as u64) << pos;
+        backslash_mask |= ((byte == b'\\') as u64) << pos;
+    }
+
+    (quote_mask, backslash_mask)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn quotes(input: &[u8]) -> Vec<usize> {
+        let mut quotes = Vec::new();
+        find_quotes(input, &mut quotes);
+        quotes
+    }
+
+    #[test]
+    fn finds_unescaped_quotes() {
+        assert_eq!(quotes(br#"["foo","bar"]"#), [1, 5, 7, 11]);
+        assert_eq!(quotes(br#"["f\"o\\","b"]"#), [1, 8, 10, 12]);
+
+        let mut input = vec![b' '; 2 * BLOCK_LEN];
+        input[BLOCK_LEN - 1] = b'\\';
+        input[BLOCK_LEN] = b'"';
+        input[BLOCK_LEN + 1] = b'"';
+        input[3] = b'"';
+
+        assert_eq!(quotes(&input), [3, BLOCK_LEN + 1]);
+
+        let mut expected = Vec::new();
+        scan(&input, 0, false, &mut expected);
+
+        assert_eq!(quotes(&input), expected);
+    }
+}
@@ -23,6 +23,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <functional>
 
+#include <QCheckBox>
 #include <QClipboard>
 #include <QComboBox>
 #include <QDockWidget>
@@ -32,6 +33,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 #include <QLineEdit>
 #include <QLabel>
 #include <QMenu>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QShortcut>
 #include <QStatusBar>
@@ -56,6 +58,8 @@ constexpr auto errorMessageTimeout = 10 * 1000;
 
 constexpr auto searchTimeout = 200;
 
+constexpr auto progressBarMaximum = 1000;
+
 constexpr auto minimumChannelLength = 10;
 constexpr auto minimumTopicLength = 30;
 
@@ -111,7 +115,6 @@ MainWindow::MainWindow(Settings& settings, Model& model, Application& applicatio
 
     connect(m_tableView, &QTableView::activated, this, &MainWindow::activated);
     connect(m_tableView->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::currentChanged);
-    connect(m_tableView->horizontalHeader(), &QHeaderView::sortIndicatorChanged, this, &MainWindow::sortIndicatorChanged);
     connect(m_tableView, &QTableView::customContextMenuRequested, this, &MainWindow::customContextMenuRequested);
 
     const auto searchDock = new QDockWidget(tr("Search"), this);
@@ -146,6 +149,12 @@ MainWindow::MainWindow(Settings& settings, Model& model, Application& applicatio
     m_titleEdit->setFocus();
     searchLayout->addRow(tr("Title"), m_titleEdit);
 
+    m_descriptionSearchEdit = new QLineEdit(searchWidget);
+    searchLayout->addRow(tr("Description"), m_descriptionSearchEdit);
+
+    m_relevanceBox = new QCheckBox(tr("Sort by relevance"), searchWidget);
+    searchLayout->addRow(QString(), m_relevanceBox);
+
     m_tableView->horizontalHeader()->setMaximumSectionSize(qMax(m_channelBox->sizeHint().width(), m_topicBox->sizeHint().width()));
 
     connect(m_searchTimer, &QTimer::timeout, this, &MainWindow::timeout);
@@ -154,6 +163,22 @@ MainWindow::MainWindow(Settings& settings, Model& model, Application& applicatio
     connect(m_channelBox, &QComboBox::currentTextChanged, m_searchTimer, startTimer);
     connect(m_topicBox, &QComboBox::currentTextChanged, m_searchTimer, startTimer);
     connect(m_titleEdit, &QLineEdit::textChanged, m_searchTimer, startTimer);
+    connect(m_descriptionSearchEdit, &QLineEdit::textChanged, m_searchTimer, startTimer);
+
+    connect(m_relevanceBox, &QCheckBox::toggled, &m_model, &Model::sortByRelevance);
+
+    enableDescriptionSearch();
+
+    m_searchLabel = new QLabel(tr("Searching..."), this);
+    m_searchLabel->setVisible(false);
+    statusBar()->addPermanentWidget(m_searchLabel);
+
+    m_updateProgressBar = new QProgressBar(this);
+    m_updateProgressBar->setVisible(false);
+    statusBar()->addPermanentWidget(m_updateProgressBar);
+
+    connect(&m_model, &Model::startedSearch, this, &MainWindow::showStartedSearch);
+    connect(&m_model, &Model::completedSearch, this, &MainWindow::showCompletedSearch);
 
     const auto buttonsWidget = new QWidget(searchWidget);
     searchLayout->addWidget(buttonsWidget);
@@ -169,11 +194,16 @@ MainWindow::MainWindow(Settings& settings, Model& model, Application& applicatio
     const auto updateDatabaseButton = new QPushButton(QIcon::fromTheme(QStringLiteral("view-refresh")), QString(), buttonsWidget);
     buttonsLayout->addWidget(updateDatabaseButton);
 
+    m_cancelUpdateDatabaseButton = new QPushButton(QIcon::fromTheme(QStringLiteral("process-stop")), QString(), buttonsWidget);
+    m_cancelUpdateDatabaseButton->setEnabled(false);
+    buttonsLayout->addWidget(m_cancelUpdateDatabaseButton);
+
     const auto editSettingsButton = new QPushButton(QIcon::fromTheme(QStringLiteral("preferences-system")), QString(), buttonsWidget);
     buttonsLayout->addWidget(editSettingsButton);
 
     connect(resetFilterButton, &QPushButton::pressed, this, &MainWindow::resetFilterPressed);
     connect(updateDatabaseButton, &QPushButton::pressed, this, &MainWindow::updateDatabasePressed);
+    connect(m_cancelUpdateDatabaseButton, &QPushButton::pressed, this, &MainWindow::cancelUpdateDatabasePressed);
     connect(editSettingsButton, &QPushButton::pressed, this, &MainWindow::editSettingsPressed);
 
     const auto detailsDock = new QDockWidget(tr("Details"), this);
@@ -242,25 +272,93 @@ void MainWindow::showStartedDatabaseUpdate()
 {
     setWindowModified(true);
     statusBar()->showMessage(tr("Started database update..."), messageTimeout);
+
+    m_updateProgressBar->setRange(0, 0);
+    m_updateProgressBar->setToolTip(QString());
+    m_updateProgressBar->setVisible(true);
+
+    m_cancelUpdateDatabaseButton->setEnabled(true);
+}
+
+void MainWindow::showDatabaseUpdateProgress(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted)
+{
+    // The download is throttled by parsing and insertion, so it approximates the overall progress.
+    if (downloadLen > 0)
+    {
+        m_updateProgressBar->setRange(0, progressBarMaximum);
+        m_updateProgressBar->setValue(static_cast< int >(qMin(downloaded, downloadLen) * progressBarMaximum / downloadLen));
+    }
+
+    constexpr auto megabyte = 1024.0 * 1024.0;
+
+    m_updateProgressBar->setToolTip(tr("Downloaded %1 MB, decompressed %2 MB, parsed %3 and inserted %4 shows.")
+                                    .arg(downloaded / megabyte, 0, 'f', 1)
+                                    .arg(decompressed / megabyte, 0, 'f', 1)
+                                    .arg(parsed)
+                                    .arg(inserted));
 }
 
 void MainWindow::showCompletedDatabaseUpdate()
 {
     setWindowModified(false);
+    m_updateProgressBar->setVisible(false);
+    m_cancelUpdateDatabaseButton->setEnabled(false);
     statusBar()->showMessage(tr("Successfully updated database."), messageTimeout);
+
+    enableDescriptionSearch();
 }
 
 void MainWindow::showDatabaseUpdateFailure(const QString& error)
 {
     setWindowModified(false);
+    m_updateProgressBar->setVisible(false);
+    m_cancelUpdateDatabaseButton->setEnabled(false);
     statusBar()->showMessage(tr("Failed to update database: %1").arg(error), errorMessageTimeout);
 }
 
+void MainWindow::showCancelledDatabaseUpdate()
+{
+    setWindowModified(false);
+    m_updateProgressBar->setVisible(false);
+    m_cancelUpdateDatabaseButton->setEnabled(false);
+    statusBar()->showMessage(tr("Cancelled database update."), messageTimeout);
+}
+
+void MainWindow::showStartedSearch()
+{
+    m_searchLabel->setVisible(true);
+}
+
+void MainWindow::showCompletedSearch(bool fuzzy)
+{
+    m_searchLabel->setVisible(false);
+
+    if (fuzzy)
+    {
+        statusBar()->showMessage(tr("No exact matches, showing similar titles."), messageTimeout);
+    }
+}
+
+// Searching descriptions depends on the index built by the last full update, not on the current settings.
+void MainWindow::enableDescriptionSearch()
+{
+    const auto enabled = m_model.descriptionsIndexed();
+
+    if (!enabled)
+    {
+        m_descriptionSearchEdit->clear();
+    }
+
+    m_descriptionSearchEdit->setEnabled(enabled);
+    m_relevanceBox->setEnabled(enabled);
+}
+
 void MainWindow::resetFilterPressed()
 {
     m_channelBox->clearEditText();
     m_topicBox->clearEditText();
     m_titleEdit->clear();
+    m_descriptionSearchEdit->clear();
 }
 
 void MainWindow::updateDatabasePressed()
@@ -268,6 +366,11 @@ void MainWindow::updateDatabasePressed()
     m_application.updateDatabase();
 }
 
+void MainWindow::cancelUpdateDatabasePressed()
+{
+    m_application.cancelUpdateDatabase();
+}
+
 void MainWindow::editSettingsPressed()
 {
     SettingsDialog(m_settings, this).exec();
@@ -332,8 +435,9 @@ void MainWindow::timeout()
     const auto channel = m_channelBox->currentText();
     const auto topic = m_topicBox->currentText();
     const auto title = m_titleEdit->text();
+    const auto description = m_descriptionSearchEdit->text();
 
-    m_model.filter(channel, topic, title);
+    m_model.filter(channel, topic, title, description);
 }
 
 void MainWindow::activated(const QModelIndex& index)
@@ -347,11 +451,6 @@ void MainWindow::currentChanged(const QModelIndex& current, const QModelIndex& /
     m_websiteLabel->setText(QStringLiteral("<a href=\"%1\">%1</a>").arg(m_model.website(current)));
 }
 
-void MainWindow::sortIndicatorChanged(int logicalIndex, Qt::SortOrder /* order */)
-{
-    m_tableView->horizontalHeader()->setSortIndicatorShown(logicalIndex != 2);
-}
-
 void MainWindow::customContextMenuRequested(const QPoint& pos)
 {
     using std::bind;
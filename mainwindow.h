@@ -24,9 +24,12 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QMainWindow>
 
+class QCheckBox;
 class QComboBox;
 class QLabel;
 class QLineEdit;
+class QProgressBar;
+class QPushButton;
 class QTableView;
 class QTextEdit;
 class QTimer;
@@ -52,12 +55,20 @@ protected:
 
 public:
     void showStartedDatabaseUpdate();
+    void showDatabaseUpdateProgress(qint64 downloadLen, qint64 downloaded, qint64 decompressed, qint64 parsed, qint64 inserted);
     void showCompletedDatabaseUpdate();
     void showDatabaseUpdateFailure(const QString& error);
+    void showCancelledDatabaseUpdate();
+
+    void showStartedSearch();
+    void showCompletedSearch(bool fuzzy);
 
 private:
+    void enableDescriptionSearch();
+
     void resetFilterPressed();
     void updateDatabasePressed();
+    void cancelUpdateDatabasePressed();
     void editSettingsPressed();
 
     void playClicked();
@@ -73,7 +84,6 @@ private:
     void timeout();
     void activated(const QModelIndex& index);
     void currentChanged(const QModelIndex& current, const QModelIndex& previous);
-    void sortIndicatorChanged(int logicalIndex, Qt::SortOrder order);
     void customContextMenuRequested(const QPoint& pos);
 
 private:
@@ -88,6 +98,13 @@ private:
     QComboBox* m_channelBox;
     QComboBox* m_topicBox;
     QLineEdit* m_titleEdit;
+    QLineEdit* m_descriptionSearchEdit;
+    QCheckBox* m_relevanceBox;
+
+    QLabel* m_searchLabel;
+    QProgressBar* m_updateProgressBar;
+
+    QPushButton* m_cancelUpdateDatabaseButton;
 
     QTextEdit* m_descriptionEdit;
     QLabel* m_websiteLabel;
@@ -28,8 +28,10 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 namespace
 {
 
-constexpr auto cacheSize = 1024;
+constexpr auto summaryCacheSize = 8192;
+constexpr auto cacheSize = 16;
 constexpr auto fetchSize = 256;
+constexpr auto windowCacheSize = 64;
 
 } // anonymous
 
@@ -38,10 +40,14 @@ namespace QMediathekView
 
 Model::Model(Database& database, QObject* parent) : QAbstractTableModel(parent),
     m_database(database),
+    m_windows(windowCacheSize),
+    m_summaryCache(summaryCacheSize),
     m_cache(cacheSize),
     m_channels(new QStringListModel(this)),
     m_topics(new QStringListModel(this))
 {
+    connect(&m_database, &Database::queried, this, &Model::queried);
+
     update();
 }
 
@@ -95,7 +101,7 @@ int Model::rowCount(const QModelIndex& parent) const
         return 0;
     }
 
-    return m_fetched;
+    return m_count;
 }
 
 QModelIndex Model::index(int row, int column, const QModelIndex& parent) const
@@ -110,12 +116,19 @@ QModelIndex Model::index(int row, int column, const QModelIndex& parent) const
         return {};
     }
 
-    if (row < 0 || row >= m_id.size())
+    if (row < 0 || row >= m_count)
     {
         return {};
     }
 
-    return createIndex(row, column, m_id.at(row));
+    const auto window = fetchWindow(row);
+
+    if (window == nullptr || row % fetchSize >= window->size())
+    {
+        return {};
+    }
+
+    return createIndex(row, column, window->at(row % fetchSize));
 }
 
 QVariant Model::data(const QModelIndex& index, int role) const
@@ -130,37 +143,34 @@ QVariant Model::data(const QModelIndex& index, int role) const
         return {};
     }
 
-    const auto id = index.internalId();
     const auto column = index.column();
 
     switch (column)
     {
     case 0:
-        return fetchShow(id, std::mem_fn(&Show::channel));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::channel));
     case 1:
-        return fetchShow(id, std::mem_fn(&Show::topic));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::topic));
     case 2:
-        return fetchShow(id, std::mem_fn(&Show::title));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::title));
     case 3:
-        return fetchShow(id, std::mem_fn(&Show::date)).toString(tr("dd.MM.yy"));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::date)).toString(tr("dd.MM.yy"));
     case 4:
-        return fetchShow(id, std::mem_fn(&Show::time)).toString(tr("hh:mm"));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::time)).toString(tr("hh:mm"));
     case 5:
-        return fetchShow(id, std::mem_fn(&Show::duration)).toString(tr("hh:mm:ss"));
+        return fetchSummary(index, std::mem_fn(&ShowSummary::duration)).toString(tr("hh:mm:ss"));
     default:
         return {};
     }
 }
 
-void Model::filter(const QString& channel, const QString& topic, const QString& title)
+void Model::filter(const QString& channel, const QString& topic, const QString& title, const QString& description)
 {
-    if (m_channel == channel && m_topic == topic && m_title == title)
+    if (m_channel == channel && m_topic == topic && m_title == title && m_description == description)
     {
         return;
     }
 
-    beginResetModel();
-
     if (m_channel != channel)
     {
         m_channel = channel;
@@ -170,10 +180,9 @@ void Model::filter(const QString& channel, const QString& topic, const QString&
 
     m_topic = topic;
     m_title = title;
+    m_description = description;
 
     query();
-
-    endResetModel();
 }
 
 void Model::sort(int column, Qt::SortOrder order)
@@ -189,6 +198,9 @@ void Model::sort(int column, Qt::SortOrder order)
     case 1:
         sortColumn = Database::SortTopic;
         break;
+    case 2:
+        sortColumn = Database::SortTitle;
+        break;
     case 3:
         sortColumn = Database::SortDate;
         break;
@@ -218,40 +230,25 @@ void Model::sort(int column, Qt::SortOrder order)
         return;
     }
 
-    beginResetModel();
-
     m_sortColumn = sortColumn;
     m_sortOrder = sortOrder;
 
     query();
-
-    endResetModel();
 }
 
-bool Model::canFetchMore(const QModelIndex& parent) const
+void Model::sortByRelevance(bool relevance)
 {
-    if (parent.isValid())
+    if (m_sortByRelevance == relevance)
     {
-        return false;
+        return;
     }
 
-    return m_id.size() > m_fetched;
-}
+    m_sortByRelevance = relevance;
 
-void Model::fetchMore(const QModelIndex& parent)
-{
-    if (parent.isValid())
+    if (!m_description.isEmpty())
     {
-        return;
+        query();
     }
-
-    const auto fetch = qMin(fetchSize, m_id.size() - m_fetched);
-
-    beginInsertRows({}, m_fetched, m_fetched + fetch - 1);
-
-    m_fetched += fetch;
-
-    endInsertRows();
 }
 
 QAbstractItemModel* Model::channels() const
@@ -264,6 +261,11 @@ QAbstractItemModel* Model::topics() const
     return m_topics;
 }
 
+bool Model::descriptionsIndexed() const
+{
+    return m_database.descriptionsIndexed();
+}
+
 QString Model::title(const QModelIndex& index) const
 {
     if (!index.isValid())
@@ -271,7 +273,7 @@ QString Model::title(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::title));
+    return fetchSummary(index, std::mem_fn(&ShowSummary::title));
 }
 
 QString Model::description(const QModelIndex& index) const
@@ -281,7 +283,7 @@ QString Model::description(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::description));
+    return fetchShow(index, std::mem_fn(&Show::description));
 }
 
 QString Model::website(const QModelIndex& index) const
@@ -291,7 +293,7 @@ QString Model::website(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::website));
+    return fetchShow(index, std::mem_fn(&Show::website));
 }
 
 QString Model::url(const QModelIndex& index) const
@@ -301,7 +303,7 @@ QString Model::url(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::url));
+    return fetchShow(index, std::mem_fn(&Show::url));
 }
 
 QString Model::urlSmall(const QModelIndex& index) const
@@ -311,7 +313,7 @@ QString Model::urlSmall(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::urlSmall));
+    return fetchShow(index, std::mem_fn(&Show::urlSmall));
 }
 
 QString Model::urlLarge(const QModelIndex& index) const
@@ -321,29 +323,142 @@ QString Model::urlLarge(const QModelIndex& index) const
         return {};
     }
 
-    return fetchShow(index.internalId(), std::mem_fn(&Show::urlLarge));
+    return fetchShow(index, std::mem_fn(&Show::urlLarge));
 }
 
 void Model::update()
 {
-    beginResetModel();
+    // Summaries fetched while the update committed might carry the names of reused channel and topic IDs.
+    m_summaryCache.clear();
+    m_cache.clear();
 
     fetchChannels();
     fetchTopics();
     query();
+}
+
+void Model::query()
+{
+    emit startedSearch();
+
+    // Relevance is only defined with respect to a description to match.
+    if (m_sortByRelevance && !m_description.isEmpty())
+    {
+        m_database.query(++m_generation, m_channel, m_topic, m_title, m_description, Database::SortRelevance, Database::SortAscending);
+    }
+    else
+    {
+        m_database.query(++m_generation, m_channel, m_topic, m_title, m_description, m_sortColumn, m_sortOrder);
+    }
+}
+
+void Model::queried(quint64 generation, int count, bool fuzzy)
+{
+    if (m_generation != generation)
+    {
+        return;
+    }
+
+    beginResetModel();
+
+    m_queriedGeneration = generation;
+    m_count = count;
+
+    m_windows.clear();
 
     endResetModel();
+
+    m_database.releaseResults(generation);
+
+    emit completedSearch(fuzzy);
 }
 
-void Model::query()
+template< typename Member >
+Model::ResultOf< ShowSummary, Member > Model::fetchSummary(const QModelIndex& index, Member member) const
+{
+    const auto id = index.internalId();
+
+    if (const auto summary = m_summaryCache.object(id))
+    {
+        return member(*summary);
+    }
+
+    fetchSummaries(index.row());
+
+    if (const auto summary = m_summaryCache.object(id))
+    {
+        return member(*summary);
+    }
+
+    return member(ShowSummary());
+}
+
+const QVector< quintptr >* Model::fetchWindow(int row) const
+{
+    const auto window = row / fetchSize;
+
+    if (const auto ids = m_windows.object(window))
+    {
+        return ids;
+    }
+
+    std::unique_ptr< QVector< quintptr > > ids(new QVector< quintptr >(m_database.window(m_queriedGeneration, window * fetchSize, fetchSize)));
+
+    if (ids->isEmpty())
+    {
+        return nullptr;
+    }
+
+    const auto ids_ = ids.get();
+
+    m_windows.insert(window, ids.release());
+
+    return ids_;
+}
+
+void Model::fetchSummaries(int row) const
 {
-    m_id = m_database.query(m_channel, m_topic, m_title, m_sortColumn, m_sortOrder);
-    m_fetched = qMin(fetchSize, m_id.size());
+    if (row < 0 || row >= m_count)
+    {
+        return;
+    }
+
+    const auto window = fetchWindow(row);
+
+    if (window == nullptr)
+    {
+        return;
+    }
+
+    QVector< quintptr > ids;
+    ids.reserve(window->size());
+
+    for (const auto id : *window)
+    {
+        if (!m_summaryCache.contains(id))
+        {
+            ids.append(id);
+        }
+    }
+
+    if (ids.isEmpty())
+    {
+        return;
+    }
+
+    auto summaries = m_database.summaries(ids);
+
+    for (auto& summary : summaries)
+    {
+        m_summaryCache.insert(summary.first, summary.second.release());
+    }
 }
 
 template< typename Member >
-Model::ResultOf< Member > Model::fetchShow(const quintptr id, Member member) const
+Model::ResultOf< Show, Member > Model::fetchShow(const QModelIndex& index, Member member) const
 {
+    const auto id = index.internalId();
+
     if (const auto show = m_cache.object(id))
     {
         return member(*show);
@@ -42,6 +42,10 @@ public:
     Model(Database& database, QObject* parent = 0);
     ~Model();
 
+signals:
+    void startedSearch();
+    void completedSearch(bool fuzzy);
+
 public:
     int columnCount(const QModelIndex& parent) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
@@ -50,17 +54,16 @@ public:
     QModelIndex index(int row, int column, const QModelIndex& parent) const override;
     QVariant data(const QModelIndex& index, int role) const override;
 
-    void filter(const QString& channel, const QString& topic, const QString& title);
+    void filter(const QString& channel, const QString& topic, const QString& title, const QString& description);
     void sort(int column, Qt::SortOrder order) override;
-
-protected:
-    bool canFetchMore(const QModelIndex& parent) const override;
-    void fetchMore(const QModelIndex& parent) override;
+    void sortByRelevance(bool relevance);
 
 public:
     QAbstractItemModel* channels() const;
     QAbstractItemModel* topics() const;
 
+    bool descriptionsIndexed() const;
+
 public:
     QString title(const QModelIndex& index) const;
 
@@ -75,27 +78,43 @@ public:
     void update();
 
 private:
-    const Database& m_database;
+    Database& m_database;
 
     QString m_channel;
     QString m_topic;
     QString m_title;
+    QString m_description;
+
+    bool m_sortByRelevance = false;
 
     Database::SortColumn m_sortColumn = Database::SortColumn::SortChannel;
     Database::SortOrder m_sortOrder = Database::SortOrder::SortAscending;
 
-    QVector< quintptr > m_id;
-    int m_fetched = 0;
+    quint64 m_generation = 0;
+
+    quint64 m_queriedGeneration = 0;
+    int m_count = 0;
 
     void query();
+    void queried(quint64 generation, int count, bool fuzzy);
 
+    mutable QCache< int, QVector< quintptr > > m_windows;
+
+    const QVector< quintptr >* fetchWindow(int row) const;
+
+    mutable QCache< quintptr, ShowSummary > m_summaryCache;
     mutable QCache< quintptr, Show > m_cache;
 
+    template< typename Object, typename Member >
+    using ResultOf = typename std::decay< typename std::result_of< Member(Object) >::type >::type;
+
     template< typename Member >
-    using ResultOf = typename std::decay< typename std::result_of< Member(Show) >::type >::type;
+    ResultOf< ShowSummary, Member > fetchSummary(const QModelIndex& index, Member member) const;
+
+    void fetchSummaries(int row) const;
 
     template< typename Member >
-    ResultOf< Member > fetchShow(const quintptr id, Member member) const;
+    ResultOf< Show, Member > fetchShow(const QModelIndex& index, Member member) const;
 
     QStringListModel* m_channels;
     QStringListModel* m_topics;
@@ -27,6 +27,19 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 namespace QMediathekView
 {
 
+struct ShowSummary
+{
+    QString channel;
+    QString topic;
+    QString title;
+
+    QDate date;
+    QTime time;
+
+    QTime duration;
+
+};
+
 struct Show
 {
     QString channel;
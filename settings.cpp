@@ -42,6 +42,8 @@ DEFINE_KEY(partialListUrl);
 DEFINE_KEY(databaseUpdateAfterHours);
 DEFINE_KEY(databaseUpdatedOn);
 
+DEFINE_KEY(blobCacheSize);
+
 DEFINE_KEY(playCommand);
 DEFINE_KEY(downloadCommand);
 
@@ -49,6 +51,9 @@ DEFINE_KEY(downloadFolder);
 
 DEFINE_KEY(preferredUrl);
 
+DEFINE_KEY(indexDescriptions);
+DEFINE_KEY(substringTitleSearch);
+
 DEFINE_KEY(mainWindowGeometry);
 DEFINE_KEY(mainWindowState);
 
@@ -66,12 +71,17 @@ const auto partialListUrl = QStringLiteral("https://liste.mediathekview.de/Filml
 
 constexpr auto databaseUpdateAfterHours = 3;
 
+constexpr auto blobCacheSize = 64;
+
 const auto playCommand = QStringLiteral("vlc %1");
 
 const auto downloadFolder = QDir::homePath();
 
 constexpr auto preferredUrl = Url::Default;
 
+constexpr auto indexDescriptions = false;
+constexpr auto substringTitleSearch = false;
+
 } // Defaults
 
 } // anonymous
@@ -123,6 +133,11 @@ void Settings::resetDatabaseUpdatedOn()
     m_settings->remove(Keys::databaseUpdatedOn);
 }
 
+int Settings::blobCacheSize() const
+{
+    return m_settings->value(Keys::blobCacheSize, Defaults::blobCacheSize).toInt();
+}
+
 QString Settings::playCommand() const
 {
     return m_settings->value(Keys::playCommand, Defaults::playCommand).toString();
@@ -163,6 +178,26 @@ void Settings::setPreferredUrl(const Url type)
     m_settings->setValue(Keys::preferredUrl, int(type));
 }
 
+bool Settings::indexDescriptions() const
+{
+    return m_settings->value(Keys::indexDescriptions, Defaults::indexDescriptions).toBool();
+}
+
+void Settings::setIndexDescriptions(const bool index)
+{
+    m_settings->setValue(Keys::indexDescriptions, index);
+}
+
+bool Settings::substringTitleSearch() const
+{
+    return m_settings->value(Keys::substringTitleSearch, Defaults::substringTitleSearch).toBool();
+}
+
+void Settings::setSubstringTitleSearch(const bool search)
+{
+    m_settings->setValue(Keys::substringTitleSearch, search);
+}
+
 QByteArray Settings::mainWindowGeometry() const
 {
     return m_settings->value(Keys::mainWindowGeometry).toByteArray();
@@ -55,6 +55,8 @@ public:
     void setDatabaseUpdatedOn();
     void resetDatabaseUpdatedOn();
 
+    int blobCacheSize() const;
+
     QString playCommand() const;
     void setPlayCommand(const QString& command);
 
@@ -67,6 +69,12 @@ public:
     Url preferredUrl() const;
     void setPreferredUrl(const Url type);
 
+    bool indexDescriptions() const;
+    void setIndexDescriptions(const bool index);
+
+    bool substringTitleSearch() const;
+    void setSubstringTitleSearch(const bool search);
+
     QByteArray mainWindowGeometry() const;
     void setMainWindowGeometry(const QByteArray& geometry);
 
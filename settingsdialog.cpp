@@ -22,6 +22,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 #include "settingsdialog.h"
 
 #include <QAction>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDialogButtonBox>
 #include <QFileDialog>
@@ -72,6 +73,17 @@ SettingsDialog::SettingsDialog(
     m_preferredUrlBox->setCurrentIndex(m_preferredUrlBox->findData(int(m_settings.preferredUrl())));
     layout->addRow(tr("Preferred URL"), m_preferredUrlBox);
 
+    m_indexDescriptionsBox = new QCheckBox(tr("Index descriptions"), this);
+    m_indexDescriptionsBox->setChecked(m_settings.indexDescriptions());
+    m_indexDescriptionsBox->setToolTip(tr("Takes effect after the next full database update."));
+    layout->addRow(tr("Search"), m_indexDescriptionsBox);
+
+    m_substringTitleSearchBox = new QCheckBox(tr("Match titles by substring"), this);
+    m_substringTitleSearchBox->setChecked(m_settings.substringTitleSearch());
+    m_substringTitleSearchBox->setToolTip(tr("Titles of at least three characters are matched as one contiguous substring instead of word by word. "
+                                             "Takes effect after the next full database update."));
+    layout->addRow(QString(), m_substringTitleSearchBox);
+
     auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
     layout->addWidget(buttonBox);
 
@@ -93,6 +105,9 @@ void SettingsDialog::accept()
     m_settings.setDownloadFolder(m_downloadFolderEdit->text());
 
     m_settings.setPreferredUrl(Url(m_preferredUrlBox->currentData().toInt()));
+
+    m_settings.setIndexDescriptions(m_indexDescriptionsBox->isChecked());
+    m_settings.setSubstringTitleSearch(m_substringTitleSearchBox->isChecked());
 }
 
 void SettingsDialog::selectDownloadFolder()
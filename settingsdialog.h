@@ -24,6 +24,7 @@ along with QMediathekView.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QDialog>
 
+class QCheckBox;
 class QComboBox;
 class QLineEdit;
 class QSpinBox;
@@ -60,6 +61,9 @@ private:
 
     QComboBox* m_preferredUrlBox;
 
+    QCheckBox* m_indexDescriptionsBox;
+    QCheckBox* m_substringTitleSearchBox;
+
 };
 
 } // QMediathekView